@@ -0,0 +1,63 @@
+/*!
+ * @file      allocator_bench.cpp
+ *
+ * @brief     Lookup latency of BasicAllocation depending on the number of
+ *            allocated objects, with and without the requester index.
+ *            The last object is deallocated and allocated again, so the
+ *            data movement is constant and only the lookup cost changes.
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include "allocator.hpp"
+
+const uint32_t OBJECT_SIZE=8;
+const uint32_t ITERATIONS=20000;
+
+static double lookupLatency(uint32_t objects, bool indexed) {
+    arch_t bytes = (arch_t)objects*(3*sizeof(arch_t) + OBJECT_SIZE) + \
+                   (arch_t)objects*8*sizeof(arch_t) + 64;
+    std::unique_ptr<arch_t[]> section(new arch_t[bytes/sizeof(arch_t)]);
+    const void *startSection = section.get();
+    const void *endSection = (const char *)section.get() + bytes;
+
+    std::unique_ptr<cus::BasicAllocation> arena;
+    if(indexed==true) {
+        arena.reset(new cus::BasicAllocation(startSection,endSection,objects));
+    } else {
+        arena.reset(new cus::BasicAllocation(startSection,endSection));
+    }
+
+    std::vector<void *> requesters(objects,nullptr);
+    for(uint32_t idx=0;idx<objects;idx++) {
+        arena->allocate((arch_t)&requesters[idx],requesters[idx],OBJECT_SIZE);
+    }
+
+    void *&last = requesters[objects-1];
+    auto begin = std::chrono::steady_clock::now();
+    for(uint32_t it=0;it<ITERATIONS;it++) {
+        arena->reallocate(last,OBJECT_SIZE,OBJECT_SIZE);
+        arena->deallocate((arch_t)&last);
+        arena->allocate((arch_t)&last,last,OBJECT_SIZE);
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double,std::nano>(finish-begin).count() / \
+           ITERATIONS;
+}
+
+int main() {
+    std::cout << "objects,linear_ns,indexed_ns" << std::endl;
+    for(uint32_t objects : {10u, 100u, 1000u, 10000u, 100000u}) {
+        double linear = lookupLatency(objects,false);
+        double indexed = lookupLatency(objects,true);
+        std::cout << objects << "," << linear << "," << indexed << std::endl;
+    }
+    return 0;
+}
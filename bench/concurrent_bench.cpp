@@ -0,0 +1,146 @@
+/*!
+ * @file      concurrent_bench.cpp
+ *
+ * @brief     Contention of a thread safe BasicAllocation shared between
+ *            several threads. Every writer allocates and deallocates its own
+ *            objects while the readers query elements(). The throughput of
+ *            both groups is reported for an increasing number of threads.
+ *            The same writers are also run with a ThreadLocalAllocation,
+ *            where every thread has its own sub arena.
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include "allocator.hpp"
+
+const uint32_t OBJECT_SIZE=16;
+const uint32_t OBJECTS_PER_THREAD=16;
+const uint32_t ITERATIONS=20000;
+
+struct Result {
+    double writeOps;
+    double readOps;
+};
+
+static Result contention(uint32_t writers, uint32_t readers) {
+    arch_t bytes = (arch_t)writers*OBJECTS_PER_THREAD* \
+                   (3*sizeof(arch_t) + OBJECT_SIZE) + 64;
+    std::unique_ptr<arch_t[]> section(new arch_t[bytes/sizeof(arch_t)]);
+    cus::BasicAllocation arena(section.get(), \
+                               (const char *)section.get() + bytes);
+    arena.setThreadSafe(true);
+
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> reads(0);
+    std::vector<std::thread> threads;
+
+    for(uint32_t th=0;th<readers;th++) {
+        threads.emplace_back([&]() {
+            uint64_t local = 0;
+            while(done==false) {
+                if(arena.elements() <= writers*OBJECTS_PER_THREAD) {
+                    local++;
+                }
+            }
+            reads += local;
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> writerThreads;
+    for(uint32_t th=0;th<writers;th++) {
+        writerThreads.emplace_back([&]() {
+            void *requesters[OBJECTS_PER_THREAD];
+            for(uint32_t it=0;it<ITERATIONS;it++) {
+                void *&requester = requesters[it % OBJECTS_PER_THREAD];
+                if(it >= OBJECTS_PER_THREAD) {
+                    arena.deallocate((arch_t)&requester);
+                }
+                arena.allocate((arch_t)&requester,requester,OBJECT_SIZE);
+            }
+            // The allocator updates the requesters, so they can not be left
+            // in the arena when the thread finishes
+            for(uint32_t obj=0;obj<OBJECTS_PER_THREAD;obj++) {
+                arena.deallocate((arch_t)&requesters[obj]);
+            }
+        });
+    }
+    for(auto& writer : writerThreads) {
+        writer.join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+    done=true;
+    for(auto& reader : threads) {
+        reader.join();
+    }
+
+    double seconds = std::chrono::duration<double>(finish-begin).count();
+    // Every iteration deallocates and allocates, except the first ones
+    double writes = (double)writers*2*ITERATIONS;
+    return {writes/seconds, reads/seconds};
+}
+
+static double threadLocal(uint32_t writers) {
+    // Every sub arena starts with its BasicAllocation, after its slot
+    arch_t bytes = (arch_t)writers*(OBJECTS_PER_THREAD* \
+                   (3*sizeof(arch_t) + OBJECT_SIZE) + sizeof(arch_t) + \
+                   cus::ThreadLocalAllocation::SUB_ARENA_OVERHEAD + 64);
+    std::unique_ptr<arch_t[]> section(new arch_t[bytes/sizeof(arch_t)]);
+    cus::ThreadLocalAllocation arenas(section.get(), \
+                                      (const char *)section.get() + bytes, writers);
+    if(arenas.total() != writers) {
+        std::cerr << "The section does not hold " << writers << " sub arenas" << std::endl;
+        return 0;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> writerThreads;
+    for(uint32_t th=0;th<writers;th++) {
+        writerThreads.emplace_back([&]() {
+            cus::BasicAllocation *arena = arenas.local();
+            if(arena == nullptr) {
+                return;
+            }
+            void *requesters[OBJECTS_PER_THREAD];
+            for(uint32_t it=0;it<ITERATIONS;it++) {
+                void *&requester = requesters[it % OBJECTS_PER_THREAD];
+                if(it >= OBJECTS_PER_THREAD) {
+                    arena->deallocate((arch_t)&requester);
+                }
+                arena->allocate((arch_t)&requester,requester,OBJECT_SIZE);
+            }
+            for(uint32_t obj=0;obj<OBJECTS_PER_THREAD;obj++) {
+                arena->deallocate((arch_t)&requesters[obj]);
+            }
+        });
+    }
+    for(auto& writer : writerThreads) {
+        writer.join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(finish-begin).count();
+    return (double)writers*2*ITERATIONS/seconds;
+}
+
+int main() {
+    std::cout << "writers,readers,write_mops,read_mops,local_write_mops" << std::endl;
+    for(uint32_t writers : {1u, 2u, 4u, 8u}) {
+        double local = threadLocal(writers);
+        for(uint32_t readers : {0u, 2u}) {
+            Result result = contention(writers,readers);
+            std::cout << writers << "," << readers << "," << \
+                result.writeOps/1e6 << "," << result.readOps/1e6 << "," << \
+                local/1e6 << std::endl;
+        }
+    }
+    return 0;
+}
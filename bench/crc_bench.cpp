@@ -0,0 +1,72 @@
+/*!
+ * @file      crc_bench.cpp
+ *
+ * @brief     Throughput of MathArch::crc32 for both polynomials compared with
+ *            the bit by bit loop it replaced.
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include "allocator.hpp"
+
+const size_t TOTAL_BYTES=(size_t)1 << 28;
+
+static uint32_t bitwiseCrc(const void *start, const void *end) {
+    const uint32_t POLY = 0xedb88320;
+    const uint8_t *a = (const uint8_t *)start;
+    size_t len = (const uint8_t *)end - a;
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc ^= *a++;
+        for (int k = 0; k < 8; k++)
+            crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+    }
+    return ~crc;
+}
+
+template <typename Crc>
+static double throughput(Crc crc, const uint8_t *buffer, size_t len) {
+    size_t iterations = TOTAL_BYTES/len;
+    volatile uint32_t sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(size_t it=0;it<iterations;it++) {
+        sink = sink ^ crc(buffer, buffer+len);
+    }
+    auto finish = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(finish-begin).count();
+    return (double)(iterations*len)/seconds/1e9;
+}
+
+int main() {
+    const size_t sizes[] = {256, 4096, 64*1024, 1024*1024};
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[sizes[3]]);
+    for(size_t idx=0;idx<sizes[3];idx++) {
+        buffer[idx] = (uint8_t)(idx*151 + 3);
+    }
+
+    cus::MathArch ieee;
+    ieee.setCrcPolynomial(cus::MathArch::CRC32_IEEE);
+    cus::MathArch castagnoli;
+    castagnoli.setCrcPolynomial(cus::MathArch::CRC32C);
+
+    auto slicing = [&ieee](const void *s, const void *e) {
+        return ieee.crc32(s, e);
+    };
+    auto crc32c = [&castagnoli](const void *s, const void *e) {
+        return castagnoli.crc32(s, e);
+    };
+
+    std::cout << "bytes,bitwise_gbs,ieee_slicing8_gbs,crc32c_gbs" << std::endl;
+    for(size_t len : sizes) {
+        std::cout << len << "," \
+                  << throughput(bitwiseCrc, buffer.get(), len) << "," \
+                  << throughput(slicing, buffer.get(), len) << "," \
+                  << throughput(crc32c, buffer.get(), len) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*!
+ * @file      mgmt_bench.cpp
+ *
+ * @brief     Throughput of MemoryMgmt::memcpy2 and memcpyMirror compared with
+ *            the byte by byte loops they replaced. The areas overlap, as they
+ *            do when the allocator reorganizes the arena.
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <cstring>
+#include "mgmt.hpp"
+
+const size_t TOTAL_BYTES=(size_t)1 << 30;
+
+static void byteCopy(void *dest, const void *src, size_t len) {
+    if(dest >= src) {
+        volatile char *d = (char *)dest+len;
+        const char *s = (char *)src+len;
+        while (len--) {
+            *--d = *--s;
+        }
+    } else {
+        volatile char *d = (char *)dest;
+        const char *s = (char *)src;
+        while (len--) {
+            *d++ = *s++;
+        }
+    }
+}
+
+static void byteMirror(void *dest, const void *src, size_t len) {
+    volatile char *d = (char *)dest;
+    const char *s = (char *)src;
+    while (len--) {
+        *d++ = ~(*s++);
+    }
+}
+
+template <typename Copy>
+static double throughput(Copy copy, uint8_t *buffer, size_t len, \
+        ptrdiff_t shift) {
+    size_t iterations = TOTAL_BYTES/len;
+    auto begin = std::chrono::steady_clock::now();
+    for(size_t it=0;it<iterations;it++) {
+        // Alternate the direction, so the data keeps moving within the buffer
+        if(it & 1) {
+            copy(buffer, buffer+shift, len);
+        } else {
+            copy(buffer+shift, buffer, len);
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(finish-begin).count();
+    return (double)(iterations*len)/seconds/1e9;
+}
+
+int main() {
+    MemoryMgmt mgmt;
+    const size_t sizes[] = {64, 1024, 16*1024, 256*1024, 4*1024*1024};
+    const ptrdiff_t shift = 24;
+
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[sizes[4]+2*shift]);
+    std::memset(buffer.get(), 0x5A, sizes[4]+2*shift);
+
+    auto memcpy2 = [&mgmt](void *d, const void *s, size_t len) {
+        mgmt.memcpy2(d, s, len);
+    };
+    auto memcpyMirror = [&mgmt](void *d, const void *s, size_t len) {
+        mgmt.memcpyMirror(d, s, len);
+    };
+
+    std::cout << "bytes,byte_copy_gbs,memcpy2_gbs,byte_mirror_gbs,memcpyMirror_gbs" \
+              << std::endl;
+    for(size_t len : sizes) {
+        std::cout << len << "," \
+                  << throughput(byteCopy, buffer.get(), len, shift) << "," \
+                  << throughput(memcpy2, buffer.get(), len, shift) << "," \
+                  << throughput(byteMirror, buffer.get(), len, shift) << "," \
+                  << throughput(memcpyMirror, buffer.get(), len, shift) \
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,325 @@
+/*!
+ * @file      suite_bench.cpp
+ *
+ * @brief     Regression suite of the allocator and the containers. Every
+ *            operation is measured for a sweep of object counts, object
+ *            sizes and arena sizes, next to malloc or std::vector doing the
+ *            same work, and reported in nanoseconds per operation.
+ *
+ * @note      Usage: suite_bench.out [--json]
+ *            CSV by default, one row per measurement:
+ *            benchmark,implementation,objects,object_bytes,arena_bytes,ns_per_op
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "allocator.hpp"
+#include "vector.hpp"
+
+// Best of REPEATS runs, so the noise of the other processes is filtered
+const uint32_t REPEATS=5;
+// Bytes per CRC of the containers, so every change only checks and mirrors
+// the blocks it writes
+const uint32_t CRC_BLOCK=256;
+
+struct Sample {
+    const char *benchmark;
+    const char *implementation;
+    uint32_t objects;
+    uint32_t objectBytes;
+    arch_t arenaBytes;
+    double nsPerOp;
+};
+
+static std::vector<Sample> samples;
+
+template <typename Setup, typename Run>
+static double bestNs(uint64_t operations, Setup setup, Run run) {
+    double best = 0;
+    for(uint32_t repeat=0;repeat<REPEATS;repeat++) {
+        setup();
+        auto begin = std::chrono::steady_clock::now();
+        run();
+        auto finish = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(finish-begin).count() / \
+                    (double)operations;
+        if(repeat==0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static void record(const char *benchmark, const char *implementation, \
+        uint32_t objects, uint32_t objectBytes, arch_t arenaBytes, double ns) {
+    samples.push_back({benchmark, implementation, objects, objectBytes, \
+            arenaBytes, ns});
+}
+
+// Section for objects of objectBytes plus their addresses, times slack
+class Section {
+    public:
+        Section(uint32_t objects, uint32_t objectBytes, uint32_t slack) {
+            bytes = ((arch_t)objects*(objectBytes + 3*sizeof(arch_t))*slack + \
+                    64) & ~(arch_t)(sizeof(arch_t)-1);
+            memory.reset(new arch_t[bytes/sizeof(arch_t)]);
+        }
+        const void *start() { return memory.get(); }
+        const void *end() { return (const char *)memory.get() + bytes; }
+        arch_t bytes;
+    private:
+        std::unique_ptr<arch_t[]> memory;
+};
+
+static void allocation(uint32_t objects, uint32_t objectBytes, uint32_t slack) {
+    Section section(objects, objectBytes, slack);
+    std::vector<void *> requesters(objects, nullptr);
+    std::unique_ptr<cus::BasicAllocation> arena;
+    auto fresh = [&]() {
+        arena.reset(new cus::BasicAllocation(section.start(), section.end()));
+    };
+    auto fill = [&]() {
+        fresh();
+        for(uint32_t idx=0;idx<objects;idx++) {
+            arena->allocate((arch_t)&requesters[idx],requesters[idx],objectBytes);
+        }
+    };
+
+    record("allocate", "BasicAllocation", objects, objectBytes, section.bytes, \
+        bestNs(objects, fresh, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                arena->allocate((arch_t)&requesters[idx],requesters[idx],objectBytes);
+            }
+        }));
+    // The last object does not move any other, the first one moves all
+    record("deallocate_last", "BasicAllocation", objects, objectBytes, section.bytes, \
+        bestNs(objects, fill, [&]() {
+            for(uint32_t idx=objects;idx>0;idx--) {
+                arena->deallocate((arch_t)&requesters[idx-1]);
+            }
+        }));
+    record("deallocate_first", "BasicAllocation", objects, objectBytes, section.bytes, \
+        bestNs(objects, fill, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                arena->deallocate((arch_t)&requesters[idx]);
+            }
+        }));
+    record("reallocate_first", "BasicAllocation", objects, objectBytes, section.bytes, \
+        bestNs(2*(uint64_t)objects, fill, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                arena->reallocate(requesters[0],objectBytes,objectBytes+8);
+                arena->reallocate(requesters[0],objectBytes+8,objectBytes);
+            }
+        }));
+    record("remove_element_first", "BasicAllocation", objects, objectBytes, \
+        section.bytes, bestNs(2*(uint64_t)objects, fill, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                arena->removeElement((arch_t)&requesters[0],requesters[0],1);
+                arena->reallocate(requesters[0],objectBytes-1,objectBytes);
+            }
+        }));
+    // compact() runs shrinkData() over half of the objects deallocated
+    record("shrink_data", "BasicAllocation", objects, objectBytes, section.bytes, \
+        bestNs(1, [&]() {
+            fill();
+            arena->setDeferredFree(true);
+            arena->setCompactionThreshold(101);
+            for(uint32_t idx=0;idx<objects;idx+=2) {
+                arena->deallocate((arch_t)&requesters[idx]);
+            }
+        }, [&]() {
+            arena->compact();
+        }));
+
+    std::vector<void *> blocks(objects, nullptr);
+    record("allocate", "malloc", objects, objectBytes, 0, \
+        bestNs(objects, [&]() {
+            for(void *block : blocks) {
+                std::free(block);
+            }
+        }, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                blocks[idx] = std::malloc(objectBytes);
+            }
+        }));
+    // The blocks of the last run are still allocated
+    for(void *&block : blocks) {
+        std::free(block);
+        block = nullptr;
+    }
+    record("deallocate_first", "malloc", objects, objectBytes, 0, \
+        bestNs(objects, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                blocks[idx] = std::malloc(objectBytes);
+            }
+        }, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                std::free(blocks[idx]);
+            }
+        }));
+    for(uint32_t idx=0;idx<objects;idx++) {
+        blocks[idx] = std::malloc(objectBytes);
+    }
+    record("reallocate_first", "realloc", objects, objectBytes, 0, \
+        bestNs(2*(uint64_t)objects, []() {}, [&]() {
+            for(uint32_t idx=0;idx<objects;idx++) {
+                blocks[0] = std::realloc(blocks[0],objectBytes+8);
+                blocks[0] = std::realloc(blocks[0],objectBytes);
+            }
+        }));
+    for(void *block : blocks) {
+        std::free(block);
+    }
+}
+
+static void mirroring(arch_t arenaBytes) {
+    const uint32_t objectBytes = 64;
+    uint32_t objects = (uint32_t)(arenaBytes/2/(objectBytes + 3*sizeof(arch_t))) - 1;
+    std::unique_ptr<arch_t[]> memory(new arch_t[arenaBytes/sizeof(arch_t)]);
+    cus::CrcAllocation arena(memory.get(),(const char *)memory.get() + arenaBytes);
+    std::vector<void *> requesters(objects, nullptr);
+    for(uint32_t idx=0;idx<objects;idx++) {
+        arena.allocate((arch_t)&requesters[idx],requesters[idx],objectBytes);
+    }
+    arena.updateMirror();
+
+    const uint32_t iterations = 16;
+    record("update_mirror", "CrcAllocation", objects, objectBytes, arenaBytes, \
+        bestNs(iterations, []() {}, [&]() {
+            for(uint32_t it=0;it<iterations;it++) {
+                arena.updateMirror();
+            }
+        }));
+    record("check_consistency", "CrcAllocation", objects, objectBytes, arenaBytes, \
+        bestNs(iterations, []() {}, [&]() {
+            for(uint32_t it=0;it<iterations;it++) {
+                arena.checkConsistency();
+            }
+        }));
+    std::unique_ptr<uint8_t[]> copy(new uint8_t[arenaBytes/2]);
+    record("update_mirror", "memcpy", objects, objectBytes, arenaBytes, \
+        bestNs(iterations, []() {}, [&]() {
+            for(uint32_t it=0;it<iterations;it++) {
+                std::memcpy(copy.get(),memory.get(),arenaBytes/2);
+            }
+        }));
+}
+
+template <typename V, typename A, typename... Args>
+static void containers(const char *implementation, uint32_t elements, \
+        Args... arenaArgs) {
+    Section section(1, elements*sizeof(uint32_t), 4);
+    A arena(section.start(), section.end(), arenaArgs...);
+    std::unique_ptr<V> values;
+
+    record("push_back", implementation, elements, sizeof(uint32_t), section.bytes, \
+        bestNs(elements, [&]() {
+            values.reset();
+            values.reset(new V(arena));
+        }, [&]() {
+            for(uint32_t idx=0;idx<elements;idx++) {
+                values->push_back(idx);
+            }
+        }));
+    record("erase_first", implementation, elements, sizeof(uint32_t), section.bytes, \
+        bestNs(elements, [&]() {
+            values.reset();
+            values.reset(new V(arena));
+            for(uint32_t idx=0;idx<elements;idx++) {
+                values->push_back(idx);
+            }
+        }, [&]() {
+            for(uint32_t idx=0;idx<elements;idx++) {
+                values->erase(0);
+            }
+        }));
+    values.reset();
+}
+
+static void standardContainers(uint32_t elements) {
+    std::vector<uint32_t> values;
+    record("push_back", "std::vector", elements, sizeof(uint32_t), 0, \
+        bestNs(elements, [&]() {
+            values = std::vector<uint32_t>();
+        }, [&]() {
+            for(uint32_t idx=0;idx<elements;idx++) {
+                values.push_back(idx);
+            }
+        }));
+    record("erase_first", "std::vector", elements, sizeof(uint32_t), 0, \
+        bestNs(elements, [&]() {
+            values.assign(elements, 1);
+        }, [&]() {
+            for(uint32_t idx=0;idx<elements;idx++) {
+                values.erase(values.begin());
+            }
+        }));
+}
+
+static void printCsv() {
+    std::cout << "benchmark,implementation,objects,object_bytes,arena_bytes,ns_per_op" \
+              << std::endl;
+    for(const Sample& sample : samples) {
+        std::cout << sample.benchmark << "," << sample.implementation << "," \
+                  << sample.objects << "," << sample.objectBytes << "," \
+                  << sample.arenaBytes << "," << sample.nsPerOp << std::endl;
+    }
+}
+
+static void printJson() {
+    std::cout << "[" << std::endl;
+    for(std::size_t idx=0;idx<samples.size();idx++) {
+        const Sample& sample = samples[idx];
+        std::cout << "  {\"benchmark\": \"" << sample.benchmark \
+                  << "\", \"implementation\": \"" << sample.implementation \
+                  << "\", \"objects\": " << sample.objects \
+                  << ", \"object_bytes\": " << sample.objectBytes \
+                  << ", \"arena_bytes\": " << sample.arenaBytes \
+                  << ", \"ns_per_op\": " << sample.nsPerOp << "}" \
+                  << ((idx+1 < samples.size()) ? "," : "") << std::endl;
+    }
+    std::cout << "]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t counts[] = {16, 256, 1024};
+    const uint32_t sizes[] = {8, 64, 512};
+    // Arenas that just fit the objects and arenas with spare space
+    const uint32_t slacks[] = {1, 4};
+    for(uint32_t objects : counts) {
+        for(uint32_t objectBytes : sizes) {
+            for(uint32_t slack : slacks) {
+                allocation(objects, objectBytes, slack);
+            }
+        }
+    }
+
+    const arch_t arenas[] = {4096, 64*1024, 1024*1024};
+    for(arch_t arenaBytes : arenas) {
+        mirroring(arenaBytes);
+    }
+
+    const uint32_t elements[] = {64, 1024, 16384};
+    for(uint32_t count : elements) {
+        containers<cus::Vector<uint32_t>, cus::BasicAllocation>("Vector", count);
+        containers<cus::CrcVector<uint32_t>, cus::CrcAllocation>("CrcVector", \
+                count, CRC_BLOCK);
+        standardContainers(count);
+    }
+
+    if(argc > 1 && std::string(argv[1]) == "--json") {
+        printJson();
+    } else {
+        printCsv();
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*!
+ * @file      vector_bench.cpp
+ *
+ * @brief     Append and read throughput of the header only InlineVector
+ *            compared with the out of line cus::Vector, for both arenas.
+ *            The vectors are reserved first, so only the calls are measured
+ *            and not the arena growth.
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include "allocator.hpp"
+#include "vector.hpp"
+#include "inline_vector.hpp"
+
+const uint32_t ELEMENTS=1 << 16;
+const uint32_t ROUNDS=64;
+// Bytes per CRC, so every change only checks and mirrors the blocks it writes
+const uint32_t CRC_BLOCK=256;
+
+struct Result {
+    double appendMops;
+    double readMops;
+};
+
+template <typename V, typename A, typename... Args>
+static Result measure(uint32_t elements, uint32_t rounds, Args... arenaArgs) {
+    // A CrcAllocation keeps two copies and their CRCs
+    arch_t bytes = (arch_t)elements*sizeof(uint32_t)*4 + 16384;
+    std::unique_ptr<arch_t[]> section(new arch_t[bytes/sizeof(arch_t)]);
+    A arena(section.get(),(const char *)section.get() + bytes, arenaArgs...);
+
+    double appendSeconds = 0;
+    double readSeconds = 0;
+    volatile uint32_t sink = 0;
+    for(uint32_t round=0;round<rounds;round++) {
+        V values(arena);
+        values.reserve(elements);
+
+        auto begin = std::chrono::steady_clock::now();
+        for(uint32_t idx=0;idx<elements;idx++) {
+            values.push_back(idx);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        uint32_t sum = 0;
+        for(uint32_t idx=0;idx<elements;idx++) {
+            sum += values[idx];
+        }
+        auto finish = std::chrono::steady_clock::now();
+        sink = sink ^ sum;
+
+        appendSeconds += std::chrono::duration<double>(middle-begin).count();
+        readSeconds += std::chrono::duration<double>(finish-middle).count();
+    }
+
+    double operations = (double)elements*rounds/1e6;
+    return {operations/appendSeconds, operations/readSeconds};
+}
+
+static void report(const char *name, Result result) {
+    std::cout << name << "," << result.appendMops << "," \
+              << result.readMops << std::endl;
+}
+
+int main() {
+    std::cout << "vector,append_mops,read_mops" << std::endl;
+    report("Vector", measure<cus::Vector<uint32_t>, cus::BasicAllocation>( \
+                ELEMENTS, ROUNDS));
+    report("InlineVector", measure<cus::InlineVector<uint32_t>, \
+                cus::BasicAllocation>(ELEMENTS, ROUNDS));
+    report("CrcVector", measure<cus::CrcVector<uint32_t>, cus::CrcAllocation>( \
+                ELEMENTS, ROUNDS, CRC_BLOCK));
+    report("InlineVector<CrcPolicy>", measure<cus::InlineVector<uint32_t, \
+                cus::CrcPolicy>, cus::CrcAllocation>(ELEMENTS, ROUNDS, CRC_BLOCK));
+    return 0;
+}
@@ -23,7 +23,11 @@
  *            if double copy is needed, how many elements are in, pure dynamic,
  *            pure fixed, mixed, etc...
  *
- * @note      Threading: same allocator doesn't support different threads
+ * @note      Threading: by default an allocator belongs to a single thread.
+ *            With setThreadSafe(true) the changes take a recursive mutex and
+ *            bump a sequence counter, while the lookups, as sizeElement(),
+ *            read without the lock and retry when the sequence changed
+ *            under them.
  *
  * @date      10 May 2020
  *
@@ -34,30 +38,340 @@
 #include <cstdio>
 #include <cstdint>
 #include <iostream>
+#include <sstream>
 #include <cstring>
+#include <atomic>
 #include <mutex>
+#include <new>
+#include <chrono>
+#include <thread>
 #include "mgmt.hpp"
 #include "allocator.hpp"
 
 #define ALIGN    1
 
+// Statistics are updated with relaxed atomics, as stats() reads them without
+// locking. Without CUS_ALLOCATOR_STATS nothing is generated
+#ifdef CUS_ALLOCATOR_STATS
+#define STAT_ADD(field, value) \
+    __atomic_fetch_add(&statistics.field, (arch_t)(value), __ATOMIC_RELAXED)
+#define STAT_MAX(field, value) do { \
+        arch_t statValue = (arch_t)(value); \
+        if(statValue > __atomic_load_n(&statistics.field, __ATOMIC_RELAXED)) { \
+            __atomic_store_n(&statistics.field, statValue, __ATOMIC_RELAXED); \
+        } \
+    } while(0)
+#else
+#define STAT_ADD(field, value) do {} while(0)
+#define STAT_MAX(field, value) do {} while(0)
+#endif
+// The readers of the seqlock might repeat a lookup, so they do not count it
+#define STAT_LOOKUP(record, field, value) do { \
+        if(record) { STAT_ADD(field, value); } \
+    } while(0)
+
+// Latency of the rest of the scope, declared after the MutationGuard
+#ifdef CUS_ALLOCATOR_LATENCY
+#define LATENCY_SCOPE(operation) LatencyTimer latencyTimer(latencies, operation)
+#else
+#define LATENCY_SCOPE(operation) do {} while(0)
+#endif
+
 namespace cus {
 
+namespace {
+
+// Spins of a reader waiting for a writer before it yields the core, in case
+// the writer was preempted
+constexpr uint32_t READ_SPINS = 64;
+
+inline void cpuRelax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#endif
+}
+
+// Slicing-by-8 tables for the reflected polynomials, built at compile time
+struct CrcTable {
+    uint32_t entry[8][256];
+
+    constexpr explicit CrcTable(uint32_t poly) : entry() {
+        for(uint32_t byte=0;byte<256;byte++) {
+            uint32_t crc = byte;
+            for(uint32_t k=0;k<8;k++) {
+                crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+            }
+            entry[0][byte] = crc;
+        }
+        for(uint32_t byte=0;byte<256;byte++) {
+            for(uint32_t slice=1;slice<8;slice++) {
+                uint32_t prev = entry[slice-1][byte];
+                entry[slice][byte] = (prev >> 8) ^ entry[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+constexpr CrcTable crcTableIeee(0xedb88320);
+constexpr CrcTable crcTableCastagnoli(0x82f63b78);
+
+uint32_t crcSlicing8(const CrcTable& table, uint32_t crc, const uint8_t *a, \
+        size_t len) {
+    const uint32_t (*t)[256] = table.entry;
+    while(len && ((uintptr_t)a & (sizeof(uint64_t)-1))) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *a++) & 0xFF];
+        len--;
+    }
+    while(len >= sizeof(uint64_t)) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, a, sizeof(low));
+        memcpy(&high, a+sizeof(low), sizeof(high));
+        low ^= crc;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ \
+              t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^ \
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ \
+              t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        a += sizeof(uint64_t);
+        len -= sizeof(uint64_t);
+    }
+    while(len--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *a++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crcSse42(uint32_t crc, const uint8_t *a, size_t len) {
+    while(len && ((uintptr_t)a & (sizeof(uint64_t)-1))) {
+        crc = __builtin_ia32_crc32qi(crc, *a++);
+        len--;
+    }
+    uint64_t crc64 = crc;
+    while(len >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, a, sizeof(word));
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        a += sizeof(uint64_t);
+        len -= sizeof(uint64_t);
+    }
+    crc = (uint32_t)crc64;
+    while(len--) {
+        crc = __builtin_ia32_crc32qi(crc, *a++);
+    }
+    return crc;
+}
+
+bool hasSse42() {
+    // A CrcAllocation built during the static initialisation can get here
+    // before libgcc detects the CPU, so it is detected first, as in mgmt.cpp
+    static const bool supported = (__builtin_cpu_init(), \
+                                   __builtin_cpu_supports("sse4.2"));
+    return supported;
+}
+#endif
+
+// Multiplication modulo the reflected polynomial, where 1 << 31 is x^0
+constexpr uint32_t multModP(uint32_t a, uint32_t b, uint32_t poly) {
+    uint32_t product = 0;
+    for(uint32_t m = 1u << 31; m != 0; m >>= 1) {
+        if(a & m) {
+            product ^= b;
+            if((a & (m-1)) == 0) {
+                break;
+            }
+        }
+        b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+    }
+    return product;
+}
+
+// x^(2^n) modulo the polynomial, to advance a CRC over runs of zeros
+struct CrcPowers {
+    uint32_t poly;
+    uint32_t x2n[32];
+
+    constexpr explicit CrcPowers(uint32_t polynomial) : poly(polynomial), x2n() {
+        uint32_t power = 1u << 30;
+        x2n[0] = power;
+        for(uint32_t n=1;n<32;n++) {
+            power = multModP(power, power, poly);
+            x2n[n] = power;
+        }
+    }
+};
+
+constexpr CrcPowers crcPowersIeee(0xedb88320);
+constexpr CrcPowers crcPowersCastagnoli(0x82f63b78);
+
+// It does not read the clock if the arena has no histograms
+class LatencyTimer {
+    public:
+        LatencyTimer(LatencyHistogram *histograms, uint32_t operation) : \
+            histogram(histograms != nullptr ? &histograms[operation] : nullptr) {
+            if(histogram != nullptr) {
+                begin = std::chrono::steady_clock::now();
+            }
+        }
+        ~LatencyTimer() {
+            if(histogram != nullptr) {
+                auto elapsed = std::chrono::steady_clock::now() - begin;
+                histogram->record((arch_t)std::chrono::duration_cast< \
+                        std::chrono::nanoseconds>(elapsed).count());
+            }
+        }
+    private:
+        LatencyHistogram *histogram;
+        std::chrono::steady_clock::time_point begin;
+};
+
+struct JsonMapWriter {
+    std::ostream& out;
+    bool first;
+};
+
+void writeJsonEntry(const MapEntry& entry, void *context) {
+    JsonMapWriter& writer = *(JsonMapWriter *)context;
+    writer.out << (writer.first ? "" : ",") << "{\"offset\":" << entry.dataOffset \
+               << ",\"size\":" << entry.size << ",\"requester\":" << entry.requester \
+               << ",\"pinned\":" << (entry.pinned ? "true" : "false") \
+               << ",\"dead\":" << (entry.dead ? "true" : "false") << "}";
+    writer.first = false;
+}
+
+void writeBinaryEntry(const MapEntry& entry, void *context) {
+    std::ostream& out = *(std::ostream *)context;
+    arch_t words[MAP_ENTRY_WORDS] = {entry.dataOffset, \
+                                     entry.size | (entry.pinned ? MAP_PINNED : 0), \
+                                     entry.requester};
+    out.write((const char *)words, sizeof(words));
+}
+
+} // end namespace
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    memset(buckets,0,sizeof(buckets));
+    total=0;
+    lowest=0;
+    highest=0;
+}
+
+uint32_t LatencyHistogram::bucketOf(arch_t value) {
+    if(value < SUB_BUCKETS) {
+        return (uint32_t)value;
+    }
+    uint32_t magnitude = 63 - __builtin_clzll(value);
+    if(magnitude >= MAGNITUDES) {
+        return BUCKETS-1;
+    }
+    // The bits after the highest one select the sub bucket
+    uint32_t sub = (uint32_t)(value >> (magnitude - SUB_BITS)) & (SUB_BUCKETS-1);
+    return (magnitude - SUB_BITS + 1)*SUB_BUCKETS + sub;
+}
+
+arch_t LatencyHistogram::highestOf(uint32_t bucket) {
+    if(bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    uint32_t magnitude = bucket/SUB_BUCKETS + SUB_BITS - 1;
+    arch_t sub = bucket%SUB_BUCKETS;
+    arch_t width = (arch_t)1 << (magnitude - SUB_BITS);
+    return ((SUB_BUCKETS + sub) << (magnitude - SUB_BITS)) + width - 1;
+}
+
+void LatencyHistogram::record(arch_t nanoseconds) {
+    buckets[bucketOf(nanoseconds)]++;
+    if(total==0 || nanoseconds < lowest) {
+        lowest=nanoseconds;
+    }
+    if(nanoseconds > highest) {
+        highest=nanoseconds;
+    }
+    total++;
+}
+
+arch_t LatencyHistogram::count() const {
+    return total;
+}
+
+arch_t LatencyHistogram::min() const {
+    return lowest;
+}
+
+arch_t LatencyHistogram::max() const {
+    return highest;
+}
+
+arch_t LatencyHistogram::percentile(double percentage) const {
+    if(total==0) {
+        return 0;
+    }
+    arch_t rank = (arch_t)(percentage*total/100.0 + 0.5);
+    rank = (rank == 0) ? 1 : ((rank > total) ? total : rank);
+    arch_t seen = 0;
+    for(uint32_t bucket=0;bucket<BUCKETS;bucket++) {
+        seen += buckets[bucket];
+        if(seen >= rank) {
+            arch_t value = highestOf(bucket);
+            return (value > highest) ? highest : value;
+        }
+    }
+    return highest;
+}
+
+MathArch::MathArch() {
+    polynomial=CRC32C;
+}
+
+void MathArch::setCrcPolynomial(crcPolynomial poly) {
+    polynomial=poly;
+}
+
 uint32_t MathArch::crc32(const void *start, const void *end)
 {
-    const uint32_t POLY = 0xedb88320;
-    int k;
+    const uint8_t *a = (const uint8_t *)start;
+    const uint8_t *b = (const uint8_t *)end;
+    size_t len = (b > a) ? (size_t)(b - a) : 0;
+
+    return ~crc32Raw(0xFFFFFFFF, a, len);
+}
+
+uint32_t MathArch::crc32Raw(uint32_t crc, const void *start, size_t len)
+{
+    const uint8_t *a = (const uint8_t *)start;
+
+    if(polynomial==CRC32C) {
+#if defined(__GNUC__) && defined(__x86_64__)
+        if(hasSse42()) {
+            return crcSse42(crc, a, len);
+        }
+#endif
+        return crcSlicing8(crcTableCastagnoli, crc, a, len);
+    }
+    return crcSlicing8(crcTableIeee, crc, a, len);
+}
 
-    const char *a = (char *)start;
-    const char *b = (char *)end;
-    uint32_t len = b - a;
-    uint32_t crc = 0;
-    while (len--) {
-        crc ^= *a++;
-        for (k = 0; k < 8; k++)
-            crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+uint32_t MathArch::crc32Shift(uint32_t crc, arch_t zeros)
+{
+    const CrcPowers& powers = (polynomial==CRC32C) ? crcPowersCastagnoli : \
+                              crcPowersIeee;
+
+    // x^(8*zeros), built from the powers of two of the number of bits
+    uint32_t power = 1u << 31;
+    uint32_t k = 3;
+    while(zeros) {
+        if(zeros & 1) {
+            power = multModP(powers.x2n[k & 31], power, powers.poly);
+        }
+        zeros >>= 1;
+        k++;
     }
-    return ~crc;
+    return multModP(power, crc, powers.poly);
 }
 
 arch_t MathArch::roundUp(arch_t numToRound, uint32_t multiple)
@@ -75,6 +389,9 @@ arch_t MathArch::roundUp(arch_t numToRound, uint32_t multiple)
 BasicAllocation::BasicAllocation() {
 }
 
+BasicAllocation::~BasicAllocation() {
+}
+
 BasicAllocation::BasicAllocation(const void *startSection,const void *endSection) {
 
     sizeArena=(((((arch_t)endSection)-(arch_t)startSection)));
@@ -85,33 +402,132 @@ BasicAllocation::BasicAllocation(const void *startSection,const void *endSection
     lastAddr=0;
 }
 
+BasicAllocation::BasicAllocation(const void *startSection,const void *endSection, \
+        uint32_t indexedObjects) {
+
+    indexSlots=1;
+    while(indexSlots < ((arch_t)indexedObjects*2)) {
+        indexSlots<<=1;
+    }
+    arch_t indexBytes = indexSlots*INDEX_ELEMENTS*sizeof(arch_t);
+    // The table is placed at the top of the section, aligned to arch_t
+    arch_t endIndex = ((arch_t)endSection) & ~((arch_t)sizeof(arch_t)-1);
+
+    start=((arch_t *)(startSection));
+    if(endIndex >= (arch_t)start + indexBytes) {
+        indexTable=(arch_t *)(endIndex-indexBytes);
+        indexObjects=indexedObjects;
+        memset((void *)indexTable,0,indexBytes);
+    } else {
+        // Not even the index fits, so nothing can be allocated
+        indexTable=(arch_t *)start;
+        indexObjects=0;
+    }
+    sizeArena=((arch_t)indexTable)-(arch_t)start;
+    end=indexTable;
+
+    lastData=0;
+    lastAddr=0;
+}
+
+BasicAllocation::BasicAllocation(const void *startSection, arch_t *index, \
+        arch_t slots, uint32_t indexedObjects, arch_t tableBytes) {
+
+    start=((arch_t *)(startSection));
+    indexTable=index;
+    indexSlots=slots;
+    indexObjects=indexedObjects;
+    memset((void *)indexTable,0,indexSlots*INDEX_ELEMENTS*sizeof(arch_t));
+    sizeArena=((arch_t)indexTable)-(arch_t)start;
+    end=indexTable;
+
+    lastData=0;
+    lastAddr=0;
+    reservedTable=tableBytes;
+}
+
 bool BasicAllocation::allocate(arch_t addrRequester, void*& requester, \
         std::size_t nBytes) {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
+    return allocateAligned(addrRequester, requester, nBytes, 1);
+}
+
+bool BasicAllocation::allocateAligned(arch_t addrRequester, void*& requester, \
+        std::size_t nBytes, std::size_t alignment) {
+    MutationGuard guard(*this);
+    LATENCY_SCOPE(LATENCY_ALLOCATE);
 
     bool success=false;
-    void * currentFreeAddr = (void *)((uint8_t *)start+lastData);
 
-    uint32_t incrementSize = nBytes;
-    uint32_t addrSectorSize = lastAddr*(sizeof(arch_t));
-    uint32_t dataSectorSize = lastData;
-    uint32_t used = addrSectorSize + dataSectorSize;
+    if(alignment==0 || alignment>MAX_ALIGNMENT || (alignment&(alignment-1))!=0 || \
+            (nBytes & SIZE_FLAGS)!=0) {
+        STAT_ADD(allocationFailures, 1);
+        return false;
+    }
+
+    if(indexSlots!=0) {
+        if((lastAddr/TOTAL_ELEMENTS)-deadEntries>=indexObjects) {
+            STAT_ADD(allocationFailures, 1);
+            return false;
+        }
+    }
+
+    // The object and its entry in the address area, which can be reserved
+    arch_t needed = nBytes+tableSpace(lastAddr+TOTAL_ELEMENTS)-tableSpace(lastAddr);
+    bool tableFull = reservedTable!=0 && \
+        (lastAddr+TOTAL_ELEMENTS)*sizeof(arch_t)>reservedTable;
+    if((deadEntries!=0 || deadBytes!=0) && (tableFull || \
+            sizeArena<needed+(alignment-1)+tableSpace(lastAddr)+lastData)) {
+        // The space of the deallocated objects and the slack is needed now
+        shrinkData();
+        needed = nBytes+tableSpace(lastAddr+TOTAL_ELEMENTS)-tableSpace(lastAddr);
+        tableFull = reservedTable!=0 && \
+            (lastAddr+TOTAL_ELEMENTS)*sizeof(arch_t)>reservedTable;
+    }
+
+    // The bytes before an aligned object are left free
+    arch_t padding = roundUp((arch_t)start+lastData, alignment) - \
+                     ((arch_t)start+lastData);
+    void * currentFreeAddr = (void *)((uint8_t *)start+lastData+padding);
+
+    arch_t incrementSize = needed+padding;
+    arch_t addrSectorSize = tableSpace(lastAddr);
+    arch_t dataSectorSize = lastData;
+    arch_t used = addrSectorSize + dataSectorSize;
 
     //std::cout << incrementSize<<" "<<addrSectorSize<<" "<<dataSectorSize<<" "<<used<<" "<<sizeArena<< std::endl;
 
-    if(sizeArena>=incrementSize+used) {
+    if(sizeArena>=incrementSize+used && tableFull==false) {
+        if(indexSlots!=0) {
+            if(indexInsert(addrRequester,lastAddr/TOTAL_ELEMENTS)==false) {
+                // The requester already owns an entry
+                STAT_ADD(allocationFailures, 1);
+                return false;
+            }
+        }
         // Update pointers
         arch_t *endV = (arch_t *)end;
-        endV[((sarch_t)lastAddr*(-1))-POINTER_TO_DATA]=(arch_t)currentFreeAddr;
+        storeWord(endV[((sarch_t)lastAddr*(-1))-POINTER_TO_DATA], (arch_t)currentFreeAddr);
         requester=currentFreeAddr;
-        endV[((sarch_t)lastAddr*(-1))-DATA_SIZE]=nBytes;
-        endV[((sarch_t)lastAddr*(-1))-POINTER_TO_REQUESTER]=(arch_t)addrRequester;
+        storeWord(endV[((sarch_t)lastAddr*(-1))-DATA_SIZE], nBytes | \
+                ((arch_t)__builtin_ctzll(alignment) << ALIGNMENT_SHIFT));
+        storeWord(endV[((sarch_t)lastAddr*(-1))-POINTER_TO_REQUESTER], (arch_t)addrRequester);
         // Update Add
-        lastAddr+=TOTAL_ELEMENTS;
+        storeWord(lastAddr, lastAddr+TOTAL_ELEMENTS);
         // Update data
-        lastData += nBytes;
+        storeWord(lastData, lastData+padding+nBytes);
+        if(alignment > maxAlignment) {
+            maxAlignment = alignment;
+        }
+
+        markDirty(currentFreeAddr,nBytes);
+        markDirty((void *)(endV-lastAddr),TOTAL_ELEMENTS*sizeof(arch_t));
 
         success=true;
+        STAT_ADD(allocations, 1);
+        STAT_MAX(highWaterData, lastData);
+        STAT_MAX(highWaterAddresses, lastAddr*sizeof(arch_t));
+    } else {
+        STAT_ADD(allocationFailures, 1);
     }
 
     return success;
@@ -119,18 +535,46 @@ bool BasicAllocation::allocate(arch_t addrRequester, void*& requester, \
 
 bool BasicAllocation::deallocate(arch_t addrRequester) {
     bool valueFound=false;
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
-
-    arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
-    for(uint32_t idx=0;idx<numberOfObjects;idx++) {
-        arch_t value = (arch_t) (end[(sarch_t)idx*TOTAL_ELEMENTS*(-1) - \
-                POINTER_TO_REQUESTER]);
-        if(addrRequester==value) {
-            valueFound=true;
-            uint32_t size = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE];
-            removeFromAddresses(idx,(void *)addrRequester,size);
-            break;
+    MutationGuard guard(*this);
+    LATENCY_SCOPE(LATENCY_DEALLOCATE);
+
+    sarch_t idx = findRequester(addrRequester);
+    if(idx>=0) {
+        valueFound=true;
+        arch_t size = entrySize(idx);
+        if(deferredFree==true) {
+            // The entry stays, without requester, until the next compaction
+            arch_t *endV = (arch_t *)end;
+            // Its bytes are moved as they are until it is dropped
+            if(entryPinned(idx)) {
+                pinnedEntries--;
+            }
+            if(end[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE] != size) {
+                storeWord(endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], size);
+                markDirty((void *)&endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+                        sizeof(arch_t));
+            }
+            storeWord(endV[((TOTAL_ELEMENTS*idx)*(-1))-POINTER_TO_REQUESTER], 0);
+            markDirty((void *)&endV[((TOTAL_ELEMENTS*idx)*(-1)) - \
+                    POINTER_TO_REQUESTER],sizeof(arch_t));
+            if(indexSlots!=0) {
+                indexErase(addrRequester);
+            }
+            deadBytes+=size;
+            storeWord(deadEntries, deadEntries+1);
+            if((arch_t)idx < compactKept) {
+                // compactStep() already went through it
+                resetCompaction();
+            }
+            if(deadBytes*100 >= compactionThreshold*lastData) {
+                shrinkData();
+            }
+        } else {
+            removeFromAddresses(idx,(void *)addrRequester,size,false);
         }
+        STAT_ADD(deallocations, 1);
+    } else {
+        STAT_ADD(deallocationFailures, 1);
     }
 #ifdef TODO
     if(valueFound==false) {
@@ -142,268 +586,1673 @@ bool BasicAllocation::deallocate(arch_t addrRequester) {
 
 bool BasicAllocation::removeElement(arch_t addrRequester, void * posElement, \
         size_t size) {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
+    MutationGuard guard(*this);
+    LATENCY_SCOPE(LATENCY_REMOVE_ELEMENT);
 
-    arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
     bool valueFound=false;
-    for(uint32_t idx=0;idx<numberOfObjects;idx++) {
-        arch_t value = (arch_t) (end[(sarch_t)idx*TOTAL_ELEMENTS*(-1) - \
-                POINTER_TO_REQUESTER]);
-        if(addrRequester==value) {
-            valueFound=true;
-            removeFromAddresses(idx,posElement,size);
-            break;
-        }
+    sarch_t idx = findRequester(addrRequester);
+    if(idx>=0) {
+        valueFound=true;
+        removeFromAddresses(idx,posElement,size,false);
     }
     if(valueFound==false) {
         std::cout << "CRITICAL2" << std::endl;
     }
+    STAT_ADD(removals, valueFound ? 1 : 0);
+    STAT_ADD(removalFailures, valueFound ? 0 : 1);
 
     return valueFound;
 }
 
 
+bool BasicAllocation::removeRange(arch_t addrRequester, std::size_t first, \
+        std::size_t count) {
+    MutationGuard guard(*this);
+    LATENCY_SCOPE(LATENCY_REMOVE_ELEMENT);
+
+    bool valueFound=false;
+    sarch_t idx = findRequester(addrRequester);
+    if(idx>=0) {
+        arch_t sizeObject = entrySize(idx);
+        if(first + count <= sizeObject) {
+            valueFound=true;
+            if(count != 0) {
+                arch_t data = end[((TOTAL_ELEMENTS*idx)*(-1))-POINTER_TO_DATA];
+                removeFromAddresses(idx,(void *)(data + first),count,false);
+            }
+        }
+    }
+    STAT_ADD(removals, valueFound ? 1 : 0);
+    STAT_ADD(removalFailures, valueFound ? 0 : 1);
+
+    return valueFound;
+}
 
 bool BasicAllocation::reallocate(void*& requester, std::size_t pBytes, \
         std::size_t nBytes) {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
+    MutationGuard guard(*this);
+    LATENCY_SCOPE(LATENCY_REALLOCATE);
 
     bool success=false;
-    // check if it fits
-    bool itFits=false;
-    void * currentFreeAddr = (void *)((uint8_t *)start+lastData);
-
-    uint32_t incrementSize = nBytes - pBytes;
-    uint32_t addrSectorSize = lastAddr*(sizeof(arch_t));
-    uint32_t dataSectorSize = lastData;
-    uint32_t used = addrSectorSize + dataSectorSize;
-
-    if((sizeArena)>=incrementSize+used) {
-        itFits=true;
+    if(nBytes == 0 || (nBytes & SIZE_FLAGS) != 0) {
+        STAT_ADD(reallocationFailures, 1);
+        return false;
     }
 
-    //std::cout << incrementSize<<" "<<addrSectorSize<<" "<<dataSectorSize<<" "<<used << std::endl;
+    if(nBytes > pBytes && (deadEntries!=0 || deadBytes!=0) && \
+            sizeArena<(nBytes-pBytes)+tableSpace(lastAddr)+lastData) {
+        // The space of the deallocated objects and the slack is needed now
+        shrinkData();
+    }
 
-    //move the rest of the data
-    if(itFits==true) {
+    sarch_t idx = findData(requester);
+    if(idx>=0 && nBytes < pBytes) {
+        // The tail is left as slack, the next objects do not move
+        removeFromAddresses(idx,(void *)((char *)requester + nBytes), \
+                pBytes - nBytes,true);
+        success=true;
+    } else if(idx>=0) {
         arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
-        bool valueFound=false;
-        sarch_t idx;
-        for(idx=0;idx<numberOfObjects;idx++) {
-            arch_t *value = (arch_t *) (end[((sarch_t)idx*TOTAL_ELEMENTS*(-1)) - \
-                    POINTER_TO_DATA]);
-            if(requester==(void *)value) {
-                valueFound=true;
-                arch_t *endV = (arch_t *)end;
-                endV[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE] = nBytes;
-                // update its size
-                lastData+=(nBytes-pBytes);
-                success=true;
-                break;
+        arch_t *endV = (arch_t *)end;
+
+        // Free bytes between this object and the next one can absorb the
+        // growth without moving anything
+        arch_t endObject = (arch_t)requester + pBytes;
+        arch_t nextData = (arch_t)start + lastData;
+        if((arch_t)idx+1 < numberOfObjects) {
+            nextData = end[((TOTAL_ELEMENTS*(idx+1))*(-1))-POINTER_TO_DATA];
+        }
+        arch_t slack = (nextData > endObject) ? nextData - endObject : 0;
+        arch_t incrementSize = nBytes - pBytes;
+        arch_t shift = (incrementSize > slack) ? incrementSize - slack : 0;
+
+        // A pinned object does not move, so only the objects before it are
+        // moved, into the free space before it
+        sarch_t lastMoved = numberOfObjects-1;
+        sarch_t pinned = (shift!=0) ? nextPinned(idx) : -1;
+        if(pinned>=0) {
+            lastMoved = pinned-1;
+        }
+        if(shift!=0 && maxAlignment>1) {
+            // The moved objects keep their alignment
+            for(sarch_t value=idx+1;value<=lastMoved;value++) {
+                shift = roundUp(shift, sizeAlignment(end[((TOTAL_ELEMENTS*value)*(-1)) - \
+                                DATA_SIZE]));
+            }
+        }
+
+        arch_t addrSectorSize = tableSpace(lastAddr);
+        arch_t used = addrSectorSize + lastData;
+        bool fits = (sizeArena)>=shift+used;
+
+        arch_t dataShift = shift;
+        arch_t endMoved = (arch_t)start+lastData+shift;
+        if(pinned>=0) {
+            dataShift = 0;
+            endMoved = end[((TOTAL_ELEMENTS*pinned)*(-1))-POINTER_TO_DATA];
+            fits = false;
+            if(lastMoved > idx) {
+                arch_t endRun = end[((TOTAL_ELEMENTS*lastMoved)*(-1)) - \
+                                POINTER_TO_DATA] + entrySize(lastMoved);
+                fits = endRun+shift <= endMoved;
             }
         }
 
-        if(valueFound==true) {
-            for(uint32_t value=(numberOfObjects-1);value>idx;value--) {
+        if(fits) {
+            storeWord(endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], nBytes | \
+                (endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE] & SIZE_FLAGS));
+            markDirty((void *)&endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+                    sizeof(arch_t));
+            success=true;
+            resetCompaction();
+            // The slack left by a shrink is not released anymore
+            arch_t reused = (incrementSize < slack) ? incrementSize : slack;
+            deadBytes -= (reused < deadBytes) ? reused : deadBytes;
+
+            if(shift==0 || (arch_t)idx+1 == numberOfObjects) {
+                // Nothing else moves
+                reallocatedInPlace++;
+                markDirty((void *)endObject,incrementSize);
+            } else {
+                // The next objects and their addresses move
+                markDirty((void *)endObject,endMoved-endObject);
+                markDirty((void *)(end-lastAddr), \
+                        (lastAddr-(TOTAL_ELEMENTS*(idx+1)))*sizeof(arch_t));
+            }
+            storeWord(lastData, lastData+dataShift);
+
+            for(sarch_t value=lastMoved;shift!=0 && value>idx;value--) {
 
                 // Move data
-                arch_t data_ = end[((TOTAL_ELEMENTS*(sarch_t)value)*(-1)) - \
+                arch_t data_ = end[((TOTAL_ELEMENTS*value)*(-1)) - \
                                POINTER_TO_DATA];
 
-                void * moveTo = (void *)(data_+(nBytes-pBytes));
-                uint32_t sizeToMove = (arch_t) end[((TOTAL_ELEMENTS*\
-                            (sarch_t)value)*(-1))-DATA_SIZE];
+                void * moveTo = (void *)(data_+shift);
+                arch_t sizeToMove = entrySize(value);
 
-                memcpy2(moveTo,(void *)data_,sizeToMove);
+                relocateData(end[((TOTAL_ELEMENTS*value)*(-1))-DATA_SIZE], \
+                        moveTo,(void *)data_,sizeToMove);
+                STAT_ADD(reallocationBytesMoved, sizeToMove);
 
                 // Update pointer to the data in the address region
-                arch_t *endV = (arch_t *)end;
-                endV[((TOTAL_ELEMENTS*(sarch_t)value)*(-1))-POINTER_TO_DATA] = (arch_t)moveTo;
+                storeWord(endV[((TOTAL_ELEMENTS*value)*(-1))-POINTER_TO_DATA], (arch_t)moveTo);
 
                 // Update the pointer of the caller object to the allocated region
                 arch_t **object = (arch_t **)end[((TOTAL_ELEMENTS*
-                            (sarch_t)value)*(-1))-POINTER_TO_REQUESTER];
-                *object = (arch_t *)moveTo;
+                            value)*(-1))-POINTER_TO_REQUESTER];
+                if(object != nullptr) {
+                    storeWord(*object, (arch_t *)moveTo);
+                }
             }
+            STAT_MAX(highWaterData, lastData);
         }
     }
+    STAT_ADD(reallocations, success ? 1 : 0);
+    STAT_ADD(reallocationFailures, success ? 0 : 1);
 
     return success;
 }
 
+arch_t BasicAllocation::reallocationsInPlace() {
+    MutationGuard guard(*this);
+    return reallocatedInPlace;
+}
+
 uint32_t BasicAllocation::elements() {
-    return (lastAddr)/TOTAL_ELEMENTS;
+    arch_t addresses;
+    arch_t dead;
+    uint32_t sequenceBegin;
+    do {
+        sequenceBegin = readBegin();
+        addresses = loadWord(lastAddr);
+        dead = loadWord(deadEntries);
+    } while(readRetry(sequenceBegin));
+
+    return (addresses)/TOTAL_ELEMENTS - dead;
 }
 
-/*
 uint32_t BasicAllocation::sizeElement(void*& requester) {
-    arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
-    for(uint32_t idx=0;idx<numberOfObjects;idx++) {
-        arch_t *value = (arch_t *) (end[(sarch_t)idx*TOTAL_ELEMENTS*(-1)]);
-        if(requester==(void*)value) {
-            return end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE];
+    arch_t size;
+    uint32_t sequenceBegin;
+    do {
+        sequenceBegin = readBegin();
+        size = 0;
+        sarch_t idx = findData(requester, false);
+        if(idx >= 0) {
+            size = entrySize(idx);
         }
-    }
+    } while(readRetry(sequenceBegin));
+
+    return size;
 }
-*/
 
 void BasicAllocation::removeFromAddresses(uint32_t indexToDelete, \
-        void * element, size_t size) {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
+        void * element, size_t size, bool keepSlack) {
+    resetCompaction();
 
     arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
-    uint32_t sizeObject = end[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-DATA_SIZE];
+    arch_t sizeObject = entrySize(indexToDelete);
     if(size > sizeObject) size = sizeObject;
 
     uint8_t skipElement = 0;
-    if(size == sizeObject) {
-        skipElement = 1;
-    } else {
+    if(size != sizeObject) {
+        // The rest of the object moves down inside it
         arch_t *endV = (arch_t *)end;
-        endV[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-DATA_SIZE] = \
-                sizeObject - size;
-        memcpy2(element,(void *)((char *)element + size), \
-            sizeObject-((arch_t)(((char *)element + size))- \
-                endV[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-POINTER_TO_DATA]));
-
-        indexToDelete++;
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-DATA_SIZE], \
+                (sizeObject - size) | (endV[((TOTAL_ELEMENTS* \
+                (sarch_t)indexToDelete)*(-1))-DATA_SIZE] & SIZE_FLAGS));
+        markDirty((void *)&endV[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1)) - \
+                DATA_SIZE],sizeof(arch_t));
+        arch_t tail = sizeObject-((arch_t)(((char *)element + size))- \
+                endV[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-POINTER_TO_DATA]);
+        relocateData(endV[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-DATA_SIZE], \
+            element,(void *)((char *)element + size),tail);
+        markDirty(element,tail);
+        STAT_ADD(removalBytesMoved, tail);
+
+        if(indexToDelete+1 == numberOfObjects) {
+            storeWord(lastData, lastData-size);
+            return;
+        }
+        if(keepSlack == true) {
+            // The freed bytes after it are left as slack, which its growth
+            // or the next compaction reclaim, so the next objects do not move
+            deadBytes+=size;
+            if(deferredFree==true && \
+                    deadBytes*100 >= compactionThreshold*lastData) {
+                shrinkData();
+            }
+            return;
+        }
+    } else {
+        skipElement = 1;
+        if(entryPinned(indexToDelete)) {
+            pinnedEntries--;
+        }
+        if(indexSlots!=0) {
+            indexErase(end[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1)) - \
+                    POINTER_TO_REQUESTER]);
+        }
     }
 
-    for(uint32_t idx=indexToDelete;idx<(numberOfObjects-skipElement);idx++) {
-        // Update pointers
+    // From the removed bytes to the last object, data and addresses might
+    // move
+    uint32_t firstChanged = indexToDelete + 1 - skipElement;
+    arch_t firstMoved = (skipElement != 0) ? \
+            end[((TOTAL_ELEMENTS*(sarch_t)indexToDelete)*(-1))-POINTER_TO_DATA] : \
+            (arch_t)element;
+    markDirty((void *)firstMoved,((arch_t)start+lastData)-firstMoved);
+    markDirty((void *)(end-lastAddr), \
+            (lastAddr-(TOTAL_ELEMENTS*firstChanged))*sizeof(arch_t));
+
+    // From a pinned object on, the data stays and only the entries move
+    arch_t moveBy = size;
+    for(uint32_t idx=indexToDelete+1;idx<numberOfObjects;idx++) {
+        // Update pointers, a removed entry is taken by the next one
         arch_t *endV = (arch_t *)end;
-        sarch_t prevData = ((TOTAL_ELEMENTS*(sarch_t)idx)*(-1)) - \
-                           (skipElement*TOTAL_ELEMENTS)-POINTER_TO_DATA;
-        sarch_t prevSize=((TOTAL_ELEMENTS*(sarch_t)idx)*(-1)) - \
-                         (skipElement*TOTAL_ELEMENTS)-DATA_SIZE;
+        uint32_t newIdx = idx - skipElement;
+        sarch_t prevData = ((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_DATA;
+        sarch_t prevSize=((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE;
         sarch_t prevAddrRequester = 
-            ((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-(skipElement*TOTAL_ELEMENTS) - \
-            POINTER_TO_REQUESTER;
+            ((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_REQUESTER;
 
         arch_t oldDataAddr = end[prevData];
         arch_t sizeElement = end[prevSize];
         arch_t addrRequester = end[prevAddrRequester];
-        arch_t newDataAddr = oldDataAddr - size;
+        if((sizeElement & PINNED_OBJECT) != 0) {
+            moveBy = 0;
+        }
+        // An aligned object moves less, and the next ones after it
+        moveBy &= ~(sizeAlignment(sizeElement)-1);
+        arch_t newDataAddr = oldDataAddr - moveBy;
+
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)newIdx)*(-1))-POINTER_TO_DATA], newDataAddr);
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)newIdx)*(-1))-DATA_SIZE], sizeElement);
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)newIdx)*(-1))-POINTER_TO_REQUESTER], addrRequester);
 
-        endV[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_DATA] = newDataAddr;
-        endV[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE] = sizeElement;
-        endV[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_REQUESTER] = addrRequester;
+        // Deallocated entries waiting for a compaction have no requester
+        if(addrRequester != 0) {
+            arch_t **object = (arch_t **)addrRequester;
+            storeWord(*object, (arch_t *)newDataAddr);
 
-        arch_t **object = (arch_t **)addrRequester;
-        *object = (arch_t *)newDataAddr;
+            if(indexSlots!=0 && skipElement!=0) {
+                indexUpdate(addrRequester,newIdx);
+            }
+        }
 
-        memcpy2((void *)newDataAddr, (void *)oldDataAddr,sizeElement);
+        if(moveBy != 0) {
+            relocateData(sizeElement,(void *)newDataAddr,(void *)oldDataAddr, \
+                    sizeElement & ~SIZE_FLAGS);
+            STAT_ADD(removalBytesMoved, sizeElement & ~SIZE_FLAGS);
+        }
     }
 
-    if(size == sizeObject) {
-        lastAddr-=TOTAL_ELEMENTS;
+    if(skipElement != 0) {
+        storeWord(lastAddr, lastAddr-TOTAL_ELEMENTS);
+    }
+    if(lastAddr==0) {
+        // The slack of the removed objects goes with the last one
+        storeWord(lastData, 0);
+        deadBytes=0;
+    } else {
+        storeWord(lastData, lastData-moveBy);
     }
-    lastData-=size;
 }
 
 void BasicAllocation::shrinkData() {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
 
     arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
     arch_t expectedNextAddr = (arch_t)start;
-    lastData=0;
+    markDirty((void *)start,lastData);
+    markDirty((void *)(end-lastAddr),lastAddr*sizeof(arch_t));
+    // Entries of deallocated objects are dropped, so the next ones move to
+    // a lower index
+    arch_t kept=0;
+    arch_t *endV = (arch_t *)end;
     for(uint32_t idx=0;idx<numberOfObjects;idx++) {
         arch_t value = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_DATA];
+        arch_t size = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE];
+        arch_t addrRequester = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1)) - \
+                                   POINTER_TO_REQUESTER];
+        if(addrRequester == 0) {
+            continue;
+        }
+        if((size & PINNED_OBJECT) != 0) {
+            // It stays, the next objects go after it
+            expectedNextAddr = value;
+        }
+        expectedNextAddr = roundUp(expectedNextAddr, sizeAlignment(size));
         if(expectedNextAddr != value) {
             // Move data
-            uint32_t sizeToMove = (arch_t) end[((TOTAL_ELEMENTS*(sarch_t)idx)*\
-                    (-1))-DATA_SIZE];
-            memcpy2((void *)expectedNextAddr,(void *)value,sizeToMove);
-
-            // Update pointer to the data in the address region
-            arch_t *endV = (arch_t *)end;
-            endV[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_DATA] = expectedNextAddr;
+            relocateData(size,(void *)expectedNextAddr,(void *)value,size & ~SIZE_FLAGS);
+            STAT_ADD(compactionBytesMoved, size & ~SIZE_FLAGS);
 
             // Update the pointer of the caller object to the allocated region
-            arch_t *object = (arch_t *)end[((TOTAL_ELEMENTS*
-                        (sarch_t)idx)*(-1))-POINTER_TO_REQUESTER];
-            *object = expectedNextAddr;
+            arch_t *object = (arch_t *)addrRequester;
+            storeWord(*object, expectedNextAddr);
+        }
+        // Update the address region
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)kept)*(-1))-POINTER_TO_DATA], expectedNextAddr);
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)kept)*(-1))-DATA_SIZE], size);
+        storeWord(endV[((TOTAL_ELEMENTS*(sarch_t)kept)*(-1))-POINTER_TO_REQUESTER], addrRequester);
+        if(indexSlots!=0 && kept!=idx) {
+            indexUpdate(addrRequester,kept);
         }
-        uint32_t size = (arch_t) end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE];
-        expectedNextAddr += size;
-        lastData+=size;
+        kept++;
+        expectedNextAddr += size & ~SIZE_FLAGS;
     }
+    storeWord(lastData, expectedNextAddr-(arch_t)start);
+    storeWord(lastAddr, kept*TOTAL_ELEMENTS);
+    STAT_ADD(compactions, 1);
+    deadBytes=0;
+    storeWord(deadEntries, 0);
+    resetCompaction();
 }
 
+bool BasicAllocation::compactStep(arch_t budget) {
+    MutationGuard guard(*this);
+    STAT_ADD(compactionSteps, 1);
 
+    if(deadEntries==0 && deadBytes==0) {
+        resetCompaction();
+        return true;
+    }
 
-
-void BasicAllocation::showMap() {
     arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
+    if(numberOfObjects==0) {
+        // The slack left by the last objects has nothing to be moved over
+        storeWord(lastData, 0);
+        deadBytes=0;
+        storeWord(deadEntries, 0);
+        resetCompaction();
+        return true;
+    }
 
-    std::cout << "\nobjects : " << numberOfObjects << std::endl;
-    std::cout << "start addr: " << start << std::endl;
-    std::cout << "last data : " << lastData  << std::endl;
-    std::cout << "first addr: " << lastAddr  << std::endl;
-    std::cout << "end addr  : " << end << std::endl;
+    // Entries before compactKept are already together. The ones from
+    // compactKept to compactRead were moved down, and they are left as
+    // deallocated entries of size 0, so the table is valid between steps.
+    arch_t *endV = (arch_t *)end;
+    arch_t spent=0;
+    do {
+        sarch_t read = (sarch_t)compactRead;
+        sarch_t kept = (sarch_t)compactKept;
+        arch_t value = end[((TOTAL_ELEMENTS*read)*(-1))-POINTER_TO_DATA];
+        arch_t size = entrySize(read);
+        arch_t addrRequester = end[((TOTAL_ELEMENTS*read)*(-1)) - \
+                                   POINTER_TO_REQUESTER];
+        spent += TOTAL_ELEMENTS*sizeof(arch_t);
+        compactRead++;
+        if(addrRequester == 0) {
+            continue;
+        }
 
-    for(uint32_t idx=0;idx<numberOfObjects;idx++) {
-        arch_t value = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_DATA];
-        arch_t req = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-POINTER_TO_REQUESTER];
-        arch_t size = end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1))-DATA_SIZE];
-        std::cout << "-Present: " << (arch_t)value << " size:" << size<<" req: "<<(arch_t)req<< "\n";
+        arch_t nextAddr = roundUp((arch_t)start + compactNext, \
+                sizeAlignment(end[((TOTAL_ELEMENTS*read)*(-1))-DATA_SIZE]));
+        if(entryPinned(read)) {
+            nextAddr = value;
+        }
+        if(value != nextAddr) {
+            relocateData(end[((TOTAL_ELEMENTS*read)*(-1))-DATA_SIZE], \
+                    (void *)nextAddr,(void *)value,size);
+            STAT_ADD(compactionBytesMoved, size);
+            markDirty((void *)nextAddr,size);
+            arch_t *object = (arch_t *)addrRequester;
+            storeWord(*object, nextAddr);
+            spent += size;
+        }
+        if(kept != read || value != nextAddr) {
+            storeWord(endV[((TOTAL_ELEMENTS*kept)*(-1))-POINTER_TO_DATA], nextAddr);
+            storeWord(endV[((TOTAL_ELEMENTS*kept)*(-1))-DATA_SIZE], size | \
+                (end[((TOTAL_ELEMENTS*read)*(-1))-DATA_SIZE] & SIZE_FLAGS));
+            storeWord(endV[((TOTAL_ELEMENTS*kept)*(-1))-POINTER_TO_REQUESTER], addrRequester);
+            markDirty((void *)&endV[((TOTAL_ELEMENTS*kept)*(-1))-TOTAL_ELEMENTS], \
+                    TOTAL_ELEMENTS*sizeof(arch_t));
+        }
+        if(kept != read && indexSlots!=0) {
+            indexUpdate(addrRequester,kept);
+        }
+        compactKept++;
+        compactNext = nextAddr - (arch_t)start + size;
+    } while(compactRead<numberOfObjects && spent<budget);
+
+    if(compactRead<numberOfObjects) {
+        // The entries between the kept and the next ones to process are
+        // deallocated, or were moved down. Their data can be overwritten by
+        // the moved objects, so they are left empty before the next object
+        // to process, and other changes between steps do not move their
+        // bytes. The space after the last kept object is its slack
+        arch_t emptyAddr = end[((TOTAL_ELEMENTS*(sarch_t)compactRead)*(-1)) - \
+                               POINTER_TO_DATA];
+        for(arch_t idx=compactKept;idx<compactRead;idx++) {
+            sarch_t entry = (TOTAL_ELEMENTS*(sarch_t)idx)*(-1);
+            if(end[entry-POINTER_TO_DATA] != emptyAddr || \
+                    end[entry-DATA_SIZE] != 0 || \
+                    end[entry-POINTER_TO_REQUESTER] != 0) {
+                storeWord(endV[entry-POINTER_TO_DATA], emptyAddr);
+                storeWord(endV[entry-DATA_SIZE], 0);
+                storeWord(endV[entry-POINTER_TO_REQUESTER], 0);
+                markDirty((void *)&endV[entry-TOTAL_ELEMENTS], \
+                        TOTAL_ELEMENTS*sizeof(arch_t));
+            }
+        }
+        return false;
     }
+
+    // Only deallocated entries are left after the kept ones
+    storeWord(lastAddr, compactKept*TOTAL_ELEMENTS);
+    storeWord(lastData, compactNext);
+    STAT_ADD(compactions, 1);
+    deadBytes=0;
+    storeWord(deadEntries, 0);
+    resetCompaction();
+    return true;
 }
 
-CrcAllocation::CrcAllocation(const void *startSection,const void *endSection) {
+void BasicAllocation::resetCompaction() {
+    compactRead=0;
+    compactKept=0;
+    compactNext=0;
+}
 
-    sizeArena=((((arch_t)endSection)-(arch_t)startSection)/2)-sizeof(arch_t);
-    startCRC=((arch_t *)startSection);
-    start=((arch_t *)(((arch_t)startCRC)+sizeof(arch_t)));
-    end=((arch_t *)((arch_t)startCRC+sizeArena));
-    startMirrorCRC=((arch_t *)((arch_t)end+sizeof(arch_t))); // end goes backwards
-    startMirror=((arch_t *)((arch_t)startMirrorCRC + sizeof(arch_t)));
-    endMirror=((arch_t *)((arch_t)startMirrorCRC+sizeArena));
+void BasicAllocation::compact() {
+    MutationGuard guard(*this);
+    shrinkData();
+}
 
-    lastData=0;
-    lastAddr=0;
+void BasicAllocation::setDeferredFree(bool enable) {
+    MutationGuard guard(*this);
+    deferredFree=enable;
+    if(enable==false && deadEntries!=0) {
+        shrinkData();
+    }
+}
 
-    updateMirror();
+void BasicAllocation::setCompactionThreshold(uint32_t percentage) {
+    MutationGuard guard(*this);
+    compactionThreshold=percentage;
 }
 
-void CrcAllocation::updateMirror() {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
+arch_t BasicAllocation::releasedBytes() {
+    MutationGuard guard(*this);
+    return deadBytes;
+}
 
-    memcpyMirror((void*)startMirror,(const void*)start, \
-                 sizeArena);
-    uint32_t crcOrig = crc32((const void *)(start),(const void *)((arch_t)end-1));
-    uint32_t crcMirror=crc32((const void *)(startMirror),\
-            (const void *)((arch_t)endMirror-1));
+AllocationStats BasicAllocation::stats() {
+    AllocationStats snapshot = {};
+#ifdef CUS_ALLOCATOR_STATS
+    // All the fields are arch_t, so they are copied one by one
+    const arch_t *from = (const arch_t *)&statistics;
+    arch_t *to = (arch_t *)&snapshot;
+    for(size_t idx=0;idx<sizeof(AllocationStats)/sizeof(arch_t);idx++) {
+        to[idx] = __atomic_load_n(&from[idx], __ATOMIC_RELAXED);
+    }
+#endif
+    return snapshot;
+}
 
-    *startCRC=(arch_t)crcOrig;
-    *startMirrorCRC=(arch_t)crcMirror;
+void BasicAllocation::enableLatency(LatencyHistogram *histograms) {
+#ifdef CUS_ALLOCATOR_LATENCY
+    MutationGuard guard(*this);
+    latencies = histograms;
+#else
+    (void)histograms;
+#endif
 }
 
+LatencyHistogram BasicAllocation::latency(latencyOperation operation) {
+#ifdef CUS_ALLOCATOR_LATENCY
+    MutationGuard guard(*this);
+    if(latencies != nullptr && operation < LATENCY_OPERATIONS) {
+        return latencies[operation];
+    }
+#else
+    (void)operation;
+#endif
+    return LatencyHistogram();
+}
 
-bool CrcAllocation::checkConsistency() {
-    //std::lock_guard<std::mutex> guard(allocator_mutex);
+void BasicAllocation::resetLatency() {
+#ifdef CUS_ALLOCATOR_LATENCY
+    MutationGuard guard(*this);
+    if(latencies != nullptr) {
+        for(uint32_t operation=0;operation<LATENCY_OPERATIONS;operation++) {
+            latencies[operation].reset();
+        }
+    }
+#endif
+}
 
-    bool pass=true;
+void BasicAllocation::resetStats() {
+#ifdef CUS_ALLOCATOR_STATS
+    arch_t *fields = (arch_t *)&statistics;
+    for(size_t idx=0;idx<sizeof(AllocationStats)/sizeof(arch_t);idx++) {
+        __atomic_store_n(&fields[idx], 0, __ATOMIC_RELAXED);
+    }
+#endif
+}
 
-    // check CRC
-    uint32_t crcOrig = crc32((const void *)(start),(const void *)((arch_t)end-1));
-    uint32_t crcMirror = crc32((const void *)(startMirror),\
-            (const void *)((arch_t)endMirror-1));
-
-    if((*startCRC==(arch_t)crcOrig) && (*startMirrorCRC == (arch_t)crcMirror)) {
-    } else if ((*startCRC != (arch_t)crcOrig) && \
-            (*startMirrorCRC == (arch_t)crcMirror)) {
-        memcpyMirror((void*)start,(const void*)startMirror, \
-                     ((arch_t)end-(arch_t)start)-sizeof(arch_t));
-    } else if((*startMirrorCRC != (arch_t)crcMirror) && \
-            (*startCRC==(arch_t)crcOrig)) {
-        memcpyMirror((void*)startMirror,(const void*)start, \
-                     ((arch_t)end-(arch_t)start)-sizeof(arch_t));
-    } else {
-        pass=false;
+bool BasicAllocation::pin(arch_t addrRequester) {
+    MutationGuard guard(*this);
+
+    sarch_t idx = findRequester(addrRequester);
+    if(idx<0) {
+        return false;
     }
+    if(entryPinned(idx)==false) {
+        arch_t *endV = (arch_t *)end;
+        storeWord(endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+                endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE] | PINNED_OBJECT);
+        markDirty((void *)&endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+                sizeof(arch_t));
+        pinnedEntries++;
+    }
+    return true;
+}
 
-    return pass;
+bool BasicAllocation::unpin(arch_t addrRequester) {
+    MutationGuard guard(*this);
+
+    sarch_t idx = findRequester(addrRequester);
+    if(idx<0) {
+        return false;
+    }
+    if(entryPinned(idx)==true) {
+        arch_t *endV = (arch_t *)end;
+        storeWord(endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+                endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE] & ~PINNED_OBJECT);
+        markDirty((void *)&endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+                sizeof(arch_t));
+        pinnedEntries--;
+    }
+    return true;
+}
+
+bool BasicAllocation::isPinned(arch_t addrRequester) {
+    bool pinned;
+    uint32_t sequenceBegin;
+    do {
+        sequenceBegin = readBegin();
+        sarch_t idx = findRequester(addrRequester, false);
+        pinned = idx>=0 && entryPinned(idx);
+    } while(readRetry(sequenceBegin));
+
+    return pinned;
+}
+
+bool BasicAllocation::setRelocator(arch_t addrRequester, Relocator relocator) {
+    MutationGuard guard(*this);
+
+    sarch_t idx = findRequester(addrRequester);
+    if(idx<0) {
+        return false;
+    }
+    arch_t id = 0;
+    if(relocator != nullptr) {
+        for(uint32_t slot=0;slot<RELOCATORS && id==0;slot++) {
+            if(relocators[slot]==nullptr) {
+                relocators[slot]=relocator;
+            }
+            if(relocators[slot]==relocator) {
+                id = slot+1;
+            }
+        }
+        if(id==0) {
+            // All the ids are used by other functions
+            return false;
+        }
+    }
+    arch_t *endV = (arch_t *)end;
+    storeWord(endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+        (endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE] & ~RELOCATOR_ID) | \
+        (id << RELOCATOR_SHIFT));
+    markDirty((void *)&endV[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE], \
+            sizeof(arch_t));
+    return true;
+}
+
+void BasicAllocation::relocateData(arch_t sizeWord, void *to, void *from, \
+        std::size_t nBytes) {
+    arch_t id = (sizeWord & RELOCATOR_ID) >> RELOCATOR_SHIFT;
+    if(id == 0 || nBytes == 0) {
+        memcpy2(to,from,nBytes);
+    } else {
+        relocators[id-1](to,from,nBytes);
+    }
+}
+
+arch_t BasicAllocation::entrySize(sarch_t idx) {
+    return loadWord(end[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE]) & ~SIZE_FLAGS;
+}
+
+bool BasicAllocation::entryPinned(sarch_t idx) {
+    return (loadWord(end[((TOTAL_ELEMENTS*idx)*(-1))-DATA_SIZE]) & PINNED_OBJECT) != 0;
+}
+
+arch_t BasicAllocation::sizeAlignment(arch_t sizeWord) {
+    return ((arch_t)1) << ((sizeWord & ALIGNMENT_LOG) >> ALIGNMENT_SHIFT);
+}
+
+arch_t BasicAllocation::tableSpace(arch_t addresses) {
+    arch_t bytes = addresses*sizeof(arch_t);
+    return (bytes > reservedTable) ? bytes : reservedTable;
+}
+
+sarch_t BasicAllocation::nextPinned(sarch_t idx) {
+    if(pinnedEntries==0) {
+        return -1;
+    }
+    sarch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
+    for(sarch_t value=idx+1;value<numberOfObjects;value++) {
+        if(entryPinned(value)) {
+            return value;
+        }
+    }
+    return -1;
+}
+
+sarch_t BasicAllocation::findRequester(arch_t addrRequester, bool record) {
+    // Dead entries keep 0 as requester, so it never finds a live object
+    if(addrRequester==0) {
+        return -1;
+    }
+    STAT_LOOKUP(record, lookups, 1);
+    if(indexSlots!=0) {
+        return indexFind(addrRequester, record);
+    }
+
+    arch_t numberOfObjects=loadWord(lastAddr)/TOTAL_ELEMENTS;
+    for(uint32_t idx=0;idx<numberOfObjects;idx++) {
+        arch_t value = loadWord(end[(sarch_t)idx*TOTAL_ELEMENTS*(-1) - \
+                POINTER_TO_REQUESTER]);
+        if(addrRequester==value) {
+            STAT_LOOKUP(record, lookupScanned, idx+1);
+            return idx;
+        }
+    }
+    STAT_LOOKUP(record, lookupScanned, numberOfObjects);
+    return -1;
+}
+
+sarch_t BasicAllocation::findData(void*& requester, bool record) {
+    STAT_LOOKUP(record, lookups, 1);
+    if(indexSlots!=0) {
+        // Upper layers pass their own aMem, so its address is the key. If a
+        // copy of the pointer was passed, fall back to the scan
+        sarch_t idx = indexFind((arch_t)&requester, record);
+        if(idx>=0 && loadWord(end[((TOTAL_ELEMENTS*idx)*(-1))-POINTER_TO_DATA]) == \
+                (arch_t)loadWord(requester)) {
+            return idx;
+        }
+    }
+
+    void *data = loadWord(requester);
+    arch_t numberOfObjects=loadWord(lastAddr)/TOTAL_ELEMENTS;
+    for(uint32_t idx=0;idx<numberOfObjects;idx++) {
+        arch_t value = loadWord(end[((sarch_t)idx*TOTAL_ELEMENTS*(-1)) - \
+                POINTER_TO_DATA]);
+        if(data==(void *)value && \
+                loadWord(end[((sarch_t)idx*TOTAL_ELEMENTS*(-1))-POINTER_TO_REQUESTER])!=0) {
+            STAT_LOOKUP(record, lookupScanned, idx+1);
+            return idx;
+        }
+    }
+    STAT_LOOKUP(record, lookupScanned, numberOfObjects);
+    return -1;
+}
+
+arch_t BasicAllocation::indexSlot(arch_t key) {
+    // Fibonacci hashing, requesters are at least arch_t aligned
+    return ((key * 0x9E3779B97F4A7C15ull) >> 32) & (indexSlots-1);
+}
+
+sarch_t BasicAllocation::indexFind(arch_t key, bool record) {
+    arch_t slot = indexSlot(key);
+    STAT_LOOKUP(record, lookupScanned, 1);
+    arch_t slotKey;
+    while((slotKey = loadWord(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY])) != 0) {
+        if(slotKey == key) {
+            return (sarch_t)loadWord(indexTable[slot*INDEX_ELEMENTS+INDEX_VALUE]);
+        }
+        slot = (slot+1) & (indexSlots-1);
+        STAT_LOOKUP(record, lookupScanned, 1);
+    }
+    return -1;
+}
+
+bool BasicAllocation::indexInsert(arch_t key, arch_t idx) {
+    arch_t slot = indexSlot(key);
+    while(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY] != 0) {
+        if(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY] == key) {
+            return false;
+        }
+        slot = (slot+1) & (indexSlots-1);
+    }
+    storeWord(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY], key);
+    storeWord(indexTable[slot*INDEX_ELEMENTS+INDEX_VALUE], idx);
+    return true;
+}
+
+void BasicAllocation::indexUpdate(arch_t key, arch_t idx) {
+    arch_t slot = indexSlot(key);
+    while(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY] != 0) {
+        if(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY] == key) {
+            storeWord(indexTable[slot*INDEX_ELEMENTS+INDEX_VALUE], idx);
+            return;
+        }
+        slot = (slot+1) & (indexSlots-1);
+    }
+}
+
+void BasicAllocation::indexErase(arch_t key) {
+    arch_t mask = indexSlots-1;
+    arch_t slot = indexSlot(key);
+    while(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY] != key) {
+        if(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY] == 0) {
+            return;
+        }
+        slot = (slot+1) & mask;
+    }
+
+    // Backward shift deletion, so no tombstones are needed
+    arch_t next = slot;
+    while(true) {
+        next = (next+1) & mask;
+        arch_t nextKey = indexTable[next*INDEX_ELEMENTS+INDEX_KEY];
+        if(nextKey == 0) {
+            break;
+        }
+        arch_t home = indexSlot(nextKey);
+        // Keep the entry if its home is cyclically within (slot, next]
+        bool stays = (slot <= next) ? ((home > slot) && (home <= next)) : \
+                                      ((home > slot) || (home <= next));
+        if(stays==false) {
+            storeWord(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY], nextKey);
+            storeWord(indexTable[slot*INDEX_ELEMENTS+INDEX_VALUE], \
+                indexTable[next*INDEX_ELEMENTS+INDEX_VALUE]);
+            slot = next;
+        }
+    }
+    storeWord(indexTable[slot*INDEX_ELEMENTS+INDEX_KEY], 0);
+}
+
+void BasicAllocation::markDirty(const void *from, size_t len) {
+    (void)from;
+    (void)len;
+}
+
+void BasicAllocation::setThreadSafe(bool enable) {
+    // A change of another thread which already took the lock ends first
+    std::lock_guard<std::recursive_mutex> guard(allocator_mutex);
+    threadSafe.store(enable, std::memory_order_release);
+}
+
+uint32_t BasicAllocation::readBegin() {
+    uint32_t sequenceBegin = sequence.load(std::memory_order_acquire);
+    uint32_t spins = 0;
+    while(sequenceBegin & 1) {
+        if(spins < READ_SPINS) {
+            spins++;
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+        sequenceBegin = sequence.load(std::memory_order_acquire);
+    }
+    return sequenceBegin;
+}
+
+bool BasicAllocation::readRetry(uint32_t sequenceBegin) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence.load(std::memory_order_relaxed) != sequenceBegin;
+}
+
+void BasicAllocation::writeBegin() {
+    // Odd before any word of the change is stored
+    sequence.store(sequence.load(std::memory_order_relaxed)+1, \
+                   std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void BasicAllocation::writeEnd() {
+    // Even after all the words of the change are stored
+    std::atomic_thread_fence(std::memory_order_release);
+    sequence.store(sequence.load(std::memory_order_relaxed)+1, \
+                   std::memory_order_relaxed);
+}
+
+BasicAllocation::MutationGuard::MutationGuard(BasicAllocation& section) : \
+    owner(section) {
+    locked = owner.threadSafe.load(std::memory_order_acquire);
+    if(locked==true) {
+        owner.allocator_mutex.lock();
+        if(owner.writeDepth++ == 0) {
+            owner.writeBegin();
+        }
+    }
+}
+
+BasicAllocation::MutationGuard::~MutationGuard() {
+    if(locked==true) {
+        if(--owner.writeDepth == 0) {
+            owner.writeEnd();
+        }
+        owner.allocator_mutex.unlock();
+    }
+}
+
+MapSummary BasicAllocation::exportMap(MapVisitor visitor, void *context) {
+    MapSummary summary;
+    uint32_t sequenceBegin;
+    do {
+        sequenceBegin = readBegin();
+        summary = scanMap(visitor, context);
+    } while(readRetry(sequenceBegin));
+
+    return summary;
+}
+
+MapSummary BasicAllocation::scanMap(MapVisitor visitor, void *context) {
+    arch_t addresses=loadWord(lastAddr);
+    arch_t numberOfObjects=addresses/TOTAL_ELEMENTS;
+
+    MapSummary summary = {};
+    summary.arenaBytes = (arch_t)end - (arch_t)start;
+    summary.dataBytes = loadWord(lastData);
+    summary.tableBytes = addresses*sizeof(arch_t);
+    summary.objects = numberOfObjects;
+    summary.freeBytes = summary.arenaBytes - summary.dataBytes - tableSpace(addresses);
+
+    arch_t expectedNextAddr = 0;
+    for(arch_t idx=0;idx<numberOfObjects;idx++) {
+        MapEntry entry;
+        entry.dataOffset = loadWord(end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1)) - \
+                           POINTER_TO_DATA]) - (arch_t)start;
+        entry.size = entrySize(idx);
+        entry.requester = loadWord(end[((TOTAL_ELEMENTS*(sarch_t)idx)*(-1)) - \
+                          POINTER_TO_REQUESTER]);
+        entry.pinned = entryPinned(idx);
+        entry.dead = (entry.requester == 0);
+
+        if(entry.dead) {
+            summary.deadBytes += entry.size;
+        } else {
+            summary.liveBytes += entry.size;
+        }
+        if(entry.dataOffset > expectedNextAddr) {
+            summary.gapBytes += entry.dataOffset - expectedNextAddr;
+        }
+        expectedNextAddr = entry.dataOffset + entry.size;
+        if(visitor != nullptr) {
+            visitor(entry, context);
+        }
+    }
+    if(summary.dataBytes != 0) {
+        summary.fragmentation = (double)(summary.deadBytes + summary.gapBytes) / \
+                                (double)summary.dataBytes;
+    }
+    return summary;
+}
+
+void BasicAllocation::writeMapJson(std::ostream& out) {
+    // The objects are streamed first, as the summary needs all of them. A
+    // walk interrupted by a change is discarded, so it is kept in text
+    std::ostringstream text;
+    MapSummary summary;
+    uint32_t sequenceBegin;
+    do {
+        sequenceBegin = readBegin();
+        text.str("");
+        JsonMapWriter writer = {text, true};
+        summary = scanMap(writeJsonEntry, &writer);
+    } while(readRetry(sequenceBegin));
+
+    out << "{\"objects\":[" << text.str();
+    out << "],\"arena_bytes\":" << summary.arenaBytes \
+        << ",\"data_bytes\":" << summary.dataBytes \
+        << ",\"table_bytes\":" << summary.tableBytes \
+        << ",\"free_bytes\":" << summary.freeBytes \
+        << ",\"live_bytes\":" << summary.liveBytes \
+        << ",\"dead_bytes\":" << summary.deadBytes \
+        << ",\"gap_bytes\":" << summary.gapBytes \
+        << ",\"fragmentation\":" << summary.fragmentation << "}" << std::endl;
+}
+
+void BasicAllocation::writeMapBinary(std::ostream& out) {
+    // The header and the entries have to belong to the same state
+    std::ostringstream snapshot;
+    uint32_t sequenceBegin;
+    do {
+        sequenceBegin = readBegin();
+        snapshot.str("");
+        arch_t addresses = loadWord(lastAddr);
+        arch_t header[MAP_HEADER_WORDS] = {((arch_t)MAP_VERSION << 32) | MAP_MAGIC, \
+                                           (arch_t)end - (arch_t)start, loadWord(lastData), \
+                                           addresses*sizeof(arch_t), addresses/TOTAL_ELEMENTS, \
+                                           reservedTable};
+        snapshot.write((const char *)header, sizeof(header));
+        scanMap(writeBinaryEntry, &snapshot);
+    } while(readRetry(sequenceBegin));
+
+    std::string bytes = snapshot.str();
+    out.write(bytes.data(), bytes.size());
+}
+
+void BasicAllocation::showMap() {
+    writeMapJson(std::cout);
+}
+
+CrcAllocation::CrcAllocation(const void *startSection,const void *endSection) :
+    CrcAllocation(startSection,endSection,0) {
+}
+
+CrcAllocation::CrcAllocation(const void *startSection,const void *endSection, \
+        uint32_t blockSize) {
+
+    // Every half starts with the CRC of each block, followed by the arena
+    arch_t sizeHalf = (((arch_t)endSection)-(arch_t)startSection)/2;
+    arch_t crcWords = 1;
+    if(blockSize != 0) {
+        // Smaller blocks would spend more on CRCs than on data
+        blockSize = (blockSize < CRC_MIN_BLOCK) ? (uint32_t)CRC_MIN_BLOCK : \
+                    (uint32_t)roundUp(blockSize, sizeof(arch_t));
+    }
+    if(blockSize != 0 && blockSize < sizeHalf) {
+        // Each block needs blockSize bytes plus its CRC word
+        crcWords = (sizeHalf + blockSize + sizeof(arch_t) - 1)/ \
+                   (blockSize + sizeof(arch_t));
+    }
+
+    sizeArena=sizeHalf-(crcWords*sizeof(arch_t));
+    crcBlockSize=(crcWords==1) ? sizeArena : blockSize;
+    if(crcBlockSize==0) {
+        crcBlockSize=1;
+    }
+    crcBlocks=(sizeArena + crcBlockSize - 1)/crcBlockSize;
+
+    startCRC=((arch_t *)startSection);
+    start=startCRC+crcWords;
+    end=((arch_t *)((arch_t)start+sizeArena));
+    startMirrorCRC=end; // end goes backwards
+    startMirror=startMirrorCRC+crcWords;
+    endMirror=((arch_t *)((arch_t)startMirror+sizeArena));
+
+    lastData=0;
+    lastAddr=0;
+    dirtyRanges=0;
+    batchDepth=0;
+    batchConsistent=true;
+
+    updateMirror();
+}
+
+void CrcAllocation::updateMirror() {
+    MutationGuard guard(*this);
+    LATENCY_SCOPE(LATENCY_UPDATE_MIRROR);
+
+    memcpyMirror((void*)startMirror,(const void*)start, \
+                 sizeArena);
+    for(arch_t block=0;block<crcBlocks;block++) {
+        arch_t from = block*crcBlockSize;
+        arch_t to = (from+crcBlockSize < sizeArena) ? from+crcBlockSize : sizeArena;
+        startCRC[block]=(arch_t)crc32((const char *)start+from, \
+                (const char *)start+to);
+        startMirrorCRC[block]=(arch_t)crc32((const char *)startMirror+from, \
+                (const char *)startMirror+to);
+    }
+    STAT_ADD(crcBytes, 2*sizeArena);
+    dirtyRanges=0;
+}
+
+void CrcAllocation::markDirty(const void *from, size_t len) {
+    MutationGuard guard(*this);
+    if(len==0) {
+        return;
+    }
+    arch_t dFrom = (arch_t)from - (arch_t)start;
+    arch_t dTo = dFrom + len;
+    if((arch_t)from < (arch_t)start || dTo > sizeArena) {
+        dFrom = ((arch_t)from < (arch_t)start) ? 0 : dFrom;
+        dTo = (dTo > sizeArena) ? sizeArena : dTo;
+        if(dFrom >= dTo) {
+            return;
+        }
+    }
+
+    // The ranges which overlap or touch the new one are merged into it, so
+    // no byte is in two ranges
+    uint32_t idx=0;
+    while(idx<dirtyRanges) {
+        if(dFrom <= dirtyTo[idx] && dTo >= dirtyFrom[idx]) {
+            dFrom = (dirtyFrom[idx] < dFrom) ? dirtyFrom[idx] : dFrom;
+            dTo = (dirtyTo[idx] > dTo) ? dirtyTo[idx] : dTo;
+            dirtyRanges--;
+            dirtyFrom[idx] = dirtyFrom[dirtyRanges];
+            dirtyTo[idx] = dirtyTo[dirtyRanges];
+        } else {
+            idx++;
+        }
+    }
+
+    if(dirtyRanges < DIRTY_RANGES) {
+        dirtyFrom[dirtyRanges] = dFrom;
+        dirtyTo[dirtyRanges] = dTo;
+        dirtyRanges++;
+    } else {
+        // Out of ranges, so all of them become a single one
+        for(idx=0;idx<dirtyRanges;idx++) {
+            dFrom = (dirtyFrom[idx] < dFrom) ? dirtyFrom[idx] : dFrom;
+            dTo = (dirtyTo[idx] > dTo) ? dirtyTo[idx] : dTo;
+        }
+        dirtyFrom[0] = dFrom;
+        dirtyTo[0] = dTo;
+        dirtyRanges = 1;
+    }
+}
+
+void CrcAllocation::updateDirtyMirror() {
+    MutationGuard guard(*this);
+
+    if(batchDepth > 0) {
+        return;
+    }
+    LATENCY_SCOPE(LATENCY_UPDATE_MIRROR);
+
+    for(uint32_t range=0;range<dirtyRanges;range++) {
+        arch_t from = dirtyFrom[range];
+        while(from < dirtyTo[range]) {
+            arch_t endBlock = (from/crcBlockSize+1)*crcBlockSize;
+            arch_t to = (dirtyTo[range] < endBlock) ? dirtyTo[range] : endBlock;
+            mirrorDirty(from,to);
+            from = to;
+        }
+    }
+    dirtyRanges=0;
+}
+
+void CrcAllocation::mirrorDirty(arch_t from, arch_t to) {
+    uint32_t crcDelta = dirtyDelta(from,to);
+    memcpyMirror((uint8_t *)startMirror + from,(const uint8_t *)start + from, \
+            to - from);
+    arch_t block = from/crcBlockSize;
+    startCRC[block] ^= (arch_t)crcDelta;
+    startMirrorCRC[block] ^= (arch_t)crcDelta;
+}
+
+uint32_t CrcAllocation::dirtyDelta(arch_t from, arch_t to) {
+    // The CRC is linear, so both CRCs of a block change by the CRC of the
+    // xor between the new and the previous bytes, which is the same for both
+    // copies because the mirror is inverted. The previous bytes are still
+    // in the mirror.
+    const size_t CHUNK = 256;
+    uint8_t delta[CHUNK];
+
+    arch_t block = from/crcBlockSize;
+    arch_t endBlock = (block+1)*crcBlockSize;
+    if(endBlock > sizeArena) {
+        endBlock = sizeArena;
+    }
+    const uint8_t *orig = (const uint8_t *)start + from;
+    const uint8_t *mirror = (const uint8_t *)startMirror + from;
+    arch_t len = to - from;
+    uint32_t crcRange = 0;
+    while(len) {
+        size_t chunk = (len < CHUNK) ? len : CHUNK;
+        for(size_t idx=0;idx<chunk;idx++) {
+            delta[idx] = orig[idx] ^ (uint8_t)~mirror[idx];
+        }
+        crcRange = crc32Raw(crcRange,delta,chunk);
+        STAT_ADD(crcBytes, chunk);
+        orig += chunk;
+        mirror += chunk;
+        len -= chunk;
+    }
+    return crc32Shift(crcRange,endBlock-to);
+}
+
+bool CrcAllocation::cleanBytesAgree(arch_t from, arch_t to) {
+    const uint8_t *orig = (const uint8_t *)start;
+    const uint8_t *mirror = (const uint8_t *)startMirror;
+    for(arch_t offset=from;offset<to;offset++) {
+        bool written = false;
+        for(uint32_t range=0;range<dirtyRanges;range++) {
+            if(offset >= dirtyFrom[range] && offset < dirtyTo[range]) {
+                written = true;
+            }
+        }
+        if(written == false && orig[offset] != (uint8_t)~mirror[offset]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool CrcAllocation::checkConsistency() {
+    MutationGuard guard(*this);
+    if(batchDepth > 0) {
+        return batchConsistent;
+    }
+    LATENCY_SCOPE(LATENCY_CHECK_CONSISTENCY);
+    return checkBlocks(0,crcBlocks);
+}
+
+bool CrcAllocation::checkConsistency(const void *from, size_t len) {
+    MutationGuard guard(*this);
+    if(batchDepth > 0) {
+        return batchConsistent;
+    }
+    LATENCY_SCOPE(LATENCY_CHECK_CONSISTENCY);
+    return checkArea(from,len);
+}
+
+bool CrcAllocation::checkObject(arch_t addrRequester, arch_t offset, \
+        size_t growBytes) {
+    MutationGuard guard(*this);
+    if(batchDepth > 0) {
+        return batchConsistent;
+    }
+    LATENCY_SCOPE(LATENCY_CHECK_CONSISTENCY);
+
+    arch_t numberOfObjects=(lastAddr)/TOTAL_ELEMENTS;
+    sarch_t idx = findRequester(addrRequester);
+    arch_t dataFrom;
+    if(deadEntries != 0 || deadBytes != 0 || \
+            (deferredFree==true && growBytes==0)) {
+        // The change can compact the arena, a removal by reaching the
+        // compaction threshold
+        idx = 0;
+        dataFrom = 0;
+    } else if(idx < 0) {
+        // A new object goes after the last one
+        idx = numberOfObjects;
+        dataFrom = lastData;
+    } else {
+        dataFrom = end[((TOTAL_ELEMENTS*idx)*(-1))-POINTER_TO_DATA] - \
+                   (arch_t)start + offset;
+    }
+    // An aligned object can leave free bytes before it
+    arch_t dataTo = lastData + growBytes + maxAlignment - 1;
+    bool pass = true;
+    if(dataTo > dataFrom) {
+        pass = checkArea((const char *)start + dataFrom, dataTo - dataFrom);
+    }
+
+    // Entries of the moved objects, and the one of a new object
+    const arch_t *lowest = end - (numberOfObjects+1)*TOTAL_ELEMENTS;
+    const arch_t *highest = end - idx*TOTAL_ELEMENTS;
+    bool passAddresses = checkArea(lowest, (highest-lowest)*sizeof(arch_t));
+
+    return pass && passAddresses;
+}
+
+bool CrcAllocation::checkArea(const void *from, size_t len) {
+    arch_t first = ((arch_t)from > (arch_t)start) ? \
+                   (arch_t)from - (arch_t)start : 0;
+    arch_t last = ((arch_t)from + len > (arch_t)start) ? \
+                  (arch_t)from + len - (arch_t)start : 0;
+    if(last > sizeArena) {
+        last = sizeArena;
+    }
+    if(first >= last) {
+        return true;
+    }
+    return checkBlocks(first/crcBlockSize,((last-1)/crcBlockSize)+1);
+}
+
+bool CrcAllocation::checkBlocks(arch_t firstBlock, arch_t lastBlock) {
+    MutationGuard guard(*this);
+
+    bool pass=true;
+
+    for(arch_t block=firstBlock;block<lastBlock;block++) {
+        arch_t from = block*crcBlockSize;
+        arch_t to = (from+crcBlockSize < sizeArena) ? from+crcBlockSize : sizeArena;
+        const char *orig = (const char *)start + from;
+        const char *mirror = (const char *)startMirror + from;
+
+        // check CRC
+        uint32_t crcOrig = crc32(orig,orig+(to-from));
+        uint32_t crcMirror = crc32(mirror,mirror+(to-from));
+        STAT_ADD(crcBytes, 2*(to-from));
+
+        // The mirror still holds the bytes written since the last update as
+        // they were before, so it is checked as it is, and the original is
+        // checked as it was before those writes
+        uint32_t crcWritten = 0;
+        bool written = false;
+        for(uint32_t range=0;range<dirtyRanges;range++) {
+            arch_t dFrom = (dirtyFrom[range] > from) ? dirtyFrom[range] : from;
+            arch_t dTo = (dirtyTo[range] < to) ? dirtyTo[range] : to;
+            if(dFrom < dTo) {
+                crcWritten ^= dirtyDelta(dFrom,dTo);
+                written = true;
+            }
+        }
+        bool origOk = (startCRC[block] == (arch_t)(crcOrig ^ crcWritten));
+        bool mirrorOk = (startMirrorCRC[block] == (arch_t)crcMirror);
+        if(mirrorOk == false && origOk == false && written == true && \
+                cleanBytesAgree(from,to) == true) {
+            // Only the written bytes of the mirror are corrupted, and the
+            // original replaces them
+            origOk = true;
+        }
+
+        if(mirrorOk == true) {
+            // The written bytes are mirrored, then the mirror is the
+            // reference for the rest of the original
+            for(uint32_t range=0;range<dirtyRanges;range++) {
+                arch_t dFrom = (dirtyFrom[range] > from) ? dirtyFrom[range] : from;
+                arch_t dTo = (dirtyTo[range] < to) ? dirtyTo[range] : to;
+                if(dFrom < dTo) {
+                    memcpyMirror((char *)startMirror+dFrom,(const char *)start+dFrom, \
+                            dTo-dFrom);
+                }
+            }
+            startCRC[block] ^= (arch_t)crcWritten;
+            startMirrorCRC[block] ^= (arch_t)crcWritten;
+            if(origOk == false) {
+                restoreOriginal(from,to);
+                startCRC[block]=(arch_t)crc32(orig,orig+(to-from));
+                STAT_ADD(crcBytes, to-from);
+                STAT_ADD(crcRestores, 1);
+            }
+        } else if(origOk == true) {
+            memcpyMirror((void*)mirror,(const void*)orig,to-from);
+            startMirrorCRC[block]=(arch_t)crc32(mirror,mirror+(to-from));
+            startCRC[block]=(arch_t)crcOrig;
+            STAT_ADD(crcBytes, to-from);
+            STAT_ADD(crcRestores, 1);
+        } else {
+            pass=false;
+            STAT_ADD(crcFailures, 1);
+        }
+    }
+
+    return pass;
+}
+
+void CrcAllocation::restoreOriginal(arch_t from, arch_t to) {
+    // The words of the address area are loaded by the readers of the
+    // sequence, so they are restored one by one with atomic stores. The
+    // bytes of a word split by the block boundary are copied as they are
+    arch_t table = (arch_t)(end-loadWord(lastAddr)) - (arch_t)start;
+    if(table > sizeArena) {
+        table = sizeArena;
+    }
+    arch_t first = (from > table) ? table+roundUp(from-table, sizeof(arch_t)) : table;
+    first = (first < to) ? first : to;
+    memcpyMirror((char *)start+from,(const char *)startMirror+from,first-from);
+    arch_t offset = first;
+    for(;offset+sizeof(arch_t)<=to;offset+=sizeof(arch_t)) {
+        arch_t word;
+        memcpy(&word,(const char *)startMirror+offset,sizeof(word));
+        storeWord(*(arch_t *)((char *)start+offset), ~word);
+    }
+    memcpyMirror((char *)start+offset,(const char *)startMirror+offset,to-offset);
+}
+
+bool CrcAllocation::beginBatch() {
+    MutationGuard guard(*this);
+    if(batchDepth == 0) {
+        batchConsistent = checkConsistency();
+    }
+    batchDepth++;
+    return batchConsistent;
+}
+
+void CrcAllocation::endBatch() {
+    MutationGuard guard(*this);
+    if(batchDepth > 0) {
+        batchDepth--;
+        if(batchDepth == 0) {
+            updateDirtyMirror();
+        }
+    }
+}
+
+CrcBatch::CrcBatch(CrcAllocation& section) : arena(section) {
+    consistent = arena.beginBatch();
+}
+
+CrcBatch::~CrcBatch() {
+    arena.endBatch();
+}
+
+bool CrcBatch::isConsistent() {
+    return consistent;
+}
+
+PoolAllocation::PoolAllocation(const void *startSection,const void *endSection) {
+    arch_t first = ((arch_t)startSection + sizeof(arch_t) - 1) & \
+                   ~((arch_t)sizeof(arch_t)-1);
+    start=(arch_t *)first;
+    end=(arch_t *)((arch_t)endSection & ~((arch_t)sizeof(arch_t)-1));
+    if(end < start) {
+        end=start;
+    }
+    bump=start;
+    for(uint32_t idx=0;idx<POOL_CLASSES;idx++) {
+        freeList[idx]=nullptr;
+    }
+    objects=0;
+}
+
+std::size_t PoolAllocation::maxSize() {
+    return ((std::size_t)1) << (POOL_MIN_SHIFT + POOL_CLASSES - 1);
+}
+
+uint32_t PoolAllocation::sizeClass(std::size_t nBytes) {
+    if(nBytes <= (((std::size_t)1) << POOL_MIN_SHIFT)) {
+        return 0;
+    }
+    // Bits of the highest power of two smaller than nBytes
+    return 64 - __builtin_clzll((unsigned long long)nBytes - 1) - POOL_MIN_SHIFT;
+}
+
+bool PoolAllocation::allocate(arch_t addrRequester, void*& requester, \
+        std::size_t nBytes) {
+    // The block it owns would not be reachable anymore
+    if(blockOf(requester, addrRequester) != nullptr) {
+        return false;
+    }
+
+    return take(addrRequester, requester, nBytes);
+}
+
+bool PoolAllocation::allocateAligned(arch_t addrRequester, void*& requester, \
+        std::size_t nBytes, std::size_t alignment) {
+    if(alignment==0 || alignment>sizeof(arch_t) || (alignment&(alignment-1))!=0) {
+        return false;
+    }
+
+    return allocate(addrRequester, requester, nBytes);
+}
+
+bool PoolAllocation::take(arch_t addrRequester, void*& requester, \
+        std::size_t nBytes) {
+    if(nBytes > maxSize()) {
+        return false;
+    }
+
+    uint32_t sClass = sizeClass(nBytes);
+    arch_t *block = freeList[sClass];
+    if(block != nullptr) {
+        freeList[sClass] = (arch_t *)block[HEADER_ELEMENTS];
+    } else {
+        arch_t words = HEADER_ELEMENTS + \
+                       ((((arch_t)1) << (POOL_MIN_SHIFT + sClass))/sizeof(arch_t));
+        if((arch_t)(end - bump) < words) {
+            return false;
+        }
+        block = bump;
+        bump += words;
+    }
+
+    block[HEADER_CLASS] = sClass;
+    block[HEADER_REQUESTER] = addrRequester;
+    requester = (void *)(block + HEADER_ELEMENTS);
+    objects++;
+
+    return true;
+}
+
+arch_t* PoolAllocation::blockOf(const void *data, arch_t addrRequester) {
+    if((const arch_t *)data < start + HEADER_ELEMENTS || (const arch_t *)data >= bump || \
+            (((arch_t)data - (arch_t)start) % sizeof(arch_t)) != 0) {
+        return nullptr;
+    }
+    arch_t *block = (arch_t *)data - HEADER_ELEMENTS;
+    if(block[HEADER_REQUESTER] != addrRequester) {
+        return nullptr;
+    }
+    return block;
+}
+
+void PoolAllocation::release(arch_t *block) {
+    uint32_t sClass = (uint32_t)block[HEADER_CLASS];
+    block[HEADER_REQUESTER] = 0;
+    block[HEADER_ELEMENTS] = (arch_t)freeList[sClass];
+    freeList[sClass] = block;
+    objects--;
+}
+
+bool PoolAllocation::reallocate(void*& requester, std::size_t pBytes, \
+        std::size_t nBytes) {
+    arch_t *block = blockOf(requester, (arch_t)&requester);
+    if(block == nullptr || nBytes == 0 || nBytes > maxSize()) {
+        return false;
+    }
+    std::size_t classBytes = ((std::size_t)1) << (POOL_MIN_SHIFT + block[HEADER_CLASS]);
+    if(nBytes <= classBytes) {
+        return true;
+    }
+
+    // take() points the requester to the new block
+    void *previous = requester;
+    if(take((arch_t)&requester, requester, nBytes)==false) {
+        return false;
+    }
+    memcpy2(requester, previous, (pBytes < classBytes) ? pBytes : classBytes);
+    release(block);
+
+    return true;
+}
+
+bool PoolAllocation::removeRange(arch_t addrRequester, std::size_t first, \
+        std::size_t count) {
+    void *data = *((void **)addrRequester);
+    arch_t *block = blockOf(data, addrRequester);
+    if(block == nullptr) {
+        return false;
+    }
+    std::size_t classBytes = ((std::size_t)1) << (POOL_MIN_SHIFT + block[HEADER_CLASS]);
+    if(first + count > classBytes) {
+        return false;
+    }
+    memcpy2((uint8_t *)data + first, (uint8_t *)data + first + count, \
+            classBytes - first - count);
+
+    return true;
+}
+
+bool PoolAllocation::deallocate(arch_t addrRequester) {
+    arch_t *block = blockOf(*((void **)addrRequester), addrRequester);
+    if(block == nullptr) {
+        return false;
+    }
+    release(block);
+
+    return true;
+}
+
+uint32_t PoolAllocation::elements() {
+    return objects;
+}
+
+uint32_t PoolAllocation::sizeElement(void*& requester) {
+    arch_t *block = blockOf(requester, (arch_t)&requester);
+    if(block == nullptr) {
+        return 0;
+    }
+    return ((uint32_t)1) << (POOL_MIN_SHIFT + block[HEADER_CLASS]);
+}
+
+thread_local ThreadLocalAllocation::ThreadArenas ThreadLocalAllocation::owned;
+std::mutex ThreadLocalAllocation::instances_mutex;
+ThreadLocalAllocation *ThreadLocalAllocation::instances=nullptr;
+arch_t ThreadLocalAllocation::lastGeneration=0;
+
+ThreadLocalAllocation::ThreadLocalAllocation(const void *startSection, \
+        const void *endSection, uint32_t subArenas) {
+
+    // The slots and the sub arenas are aligned to arch_t
+    arch_t aligned = ((arch_t)startSection + sizeof(arch_t) - 1) & \
+                     ~((arch_t)sizeof(arch_t)-1);
+    arch_t first = aligned + subArenas*sizeof(arch_t);
+    arch_t object = SUB_ARENA_OVERHEAD;
+
+    slots=(arch_t *)aligned;
+    firstArena=(uint8_t *)first;
+    sizeSubArena=0;
+    if(subArenas != 0 && (arch_t)endSection > first) {
+        sizeSubArena=(((arch_t)endSection - first)/subArenas) & \
+                     ~((arch_t)sizeof(arch_t)-1);
+    }
+    if(sizeSubArena <= object) {
+        // Not even the objects fit, total() tells the configuration was
+        // rejected
+        subArenas=0;
+    }
+    this->subArenas=subArenas;
+
+    for(uint32_t slot=0;slot<subArenas;slot++) {
+        uint8_t *arena = firstArena + slot*sizeSubArena;
+        new (arena) BasicAllocation(arena+object, arena+sizeSubArena);
+        slots[slot]=SLOT_FREE;
+    }
+
+    std::lock_guard<std::mutex> guard(instances_mutex);
+    generation=++lastGeneration;
+    nextInstance=instances;
+    instances=this;
+}
+
+ThreadLocalAllocation::~ThreadLocalAllocation() {
+    {
+        // Threads finishing from now on do not give the sub arenas back
+        std::lock_guard<std::mutex> guard(instances_mutex);
+        ThreadLocalAllocation **link = &instances;
+        while(*link != this) {
+            link = &(*link)->nextInstance;
+        }
+        *link = nextInstance;
+    }
+    sarch_t idx = ownedEntry();
+    while(idx >= 0) {
+        owned.drop(idx);
+        idx = ownedEntry();
+    }
+    for(uint32_t slot=0;slot<subArenas;slot++) {
+        subArena(slot)->~BasicAllocation();
+    }
+}
+
+bool ThreadLocalAllocation::alive(ThreadLocalAllocation *instance, \
+        arch_t generation) {
+    // Called with instances_mutex held
+    for(ThreadLocalAllocation *node=instances;node!=nullptr;node=node->nextInstance) {
+        if(node==instance && node->generation==generation) {
+            return true;
+        }
+    }
+    return false;
+}
+
+sarch_t ThreadLocalAllocation::ownedEntry() {
+    for(uint32_t idx=0;idx<owned.count;idx++) {
+        if(owned.registry[idx]==this && owned.generation[idx]==generation) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+BasicAllocation* ThreadLocalAllocation::subArena(uint32_t slot) {
+    return (BasicAllocation *)(firstArena + slot*sizeSubArena);
+}
+
+BasicAllocation* ThreadLocalAllocation::local() {
+    sarch_t entry = ownedEntry();
+    if(entry >= 0) {
+        return subArena(owned.slot[entry]);
+    }
+    {
+        // Entries of the destroyed instances are not needed anymore
+        std::lock_guard<std::mutex> guard(instances_mutex);
+        for(uint32_t idx=owned.count;idx>0;idx--) {
+            if(alive(owned.registry[idx-1],owned.generation[idx-1])==false) {
+                owned.drop(idx-1);
+            }
+        }
+    }
+    if(owned.count == THREAD_ARENAS) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    for(uint32_t slot=0;slot<subArenas;slot++) {
+        bool reusable = (slots[slot]==SLOT_FREE);
+        if(slots[slot]==SLOT_ORPHAN && subArena(slot)->elements()==0) {
+            // All its objects were deallocated by other threads
+            reusable = true;
+        }
+        if(reusable==true) {
+            // Only the new owner uses it from now on. The thread which
+            // deallocated its last object might still hold its lock
+            subArena(slot)->setThreadSafe(false);
+            slots[slot]=SLOT_OWNED;
+            owned.registry[owned.count]=this;
+            owned.generation[owned.count]=generation;
+            owned.slot[owned.count]=slot;
+            owned.count++;
+            return subArena(slot);
+        }
+    }
+    return nullptr;
+}
+
+void ThreadLocalAllocation::release() {
+    sarch_t idx = ownedEntry();
+    if(idx >= 0) {
+        uint32_t slot = owned.slot[idx];
+        owned.drop(idx);
+        donate(slot);
+    }
+}
+
+uint32_t ThreadLocalAllocation::available() {
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    uint32_t free=0;
+    for(uint32_t slot=0;slot<subArenas;slot++) {
+        if(slots[slot]==SLOT_FREE || \
+                (slots[slot]==SLOT_ORPHAN && subArena(slot)->elements()==0)) {
+            free++;
+        }
+    }
+    return free;
+}
+
+uint32_t ThreadLocalAllocation::total() {
+    return subArenas;
+}
+
+void ThreadLocalAllocation::donate(uint32_t slot) {
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    // Objects still alive might be destroyed from other threads until the
+    // sub arena gets a new owner
+    subArena(slot)->setThreadSafe(true);
+    if(subArena(slot)->elements()==0) {
+        slots[slot]=SLOT_FREE;
+    } else {
+        slots[slot]=SLOT_ORPHAN;
+    }
+}
+
+ThreadLocalAllocation::ThreadArenas::~ThreadArenas() {
+    // The instance can not be destroyed while its sub arena is given back
+    std::lock_guard<std::mutex> guard(instances_mutex);
+    for(uint32_t idx=0;idx<count;idx++) {
+        if(alive(registry[idx],generation[idx])==true) {
+            registry[idx]->donate(slot[idx]);
+        }
+    }
+}
+
+void ThreadLocalAllocation::ThreadArenas::drop(uint32_t idx) {
+    count--;
+    registry[idx]=registry[count];
+    generation[idx]=generation[count];
+    slot[idx]=slot[count];
 }
 
 
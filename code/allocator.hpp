@@ -7,7 +7,9 @@
  *            It is part of the cus namespace and it proposes a new way to
  *            manage the memory:
  *              - It allows to double copy the object and restore it if possible
- *              - It completely removes the memory fragmentation
+ *              - It completely removes the memory fragmentation. Only the
+ *                objects shrunk by reallocate() keep their freed bytes until
+ *                they grow again or the arena is compacted
  *              - It allows to define multiple BasicAllocation objects, so
  *                sections of memory can be independent
  *              - It allows to define the size and the specific addresses of the
@@ -16,6 +18,8 @@
  *              - Every dynamic resize will reallocate all the objects in the
  *                BasicAllocation, so it will modify the pointer to the allocated
  *                section in upper layers
+ *              - A BasicAllocation can be shared between threads once
+ *                setThreadSafe() was called
  *
  * @note      Every BasicAllocation object will get its own enviroment:
  *             - If BasicAllocation object was constructed with CRC support:
@@ -62,7 +66,11 @@
 #include <cstdio>
 #include <cstdint>
 #include <iostream>
+#include <atomic>
 #include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "mgmt.hpp"
 
 typedef uint64_t arch_t;
@@ -71,14 +79,221 @@ typedef signed long long sarch_t;
 
 namespace cus {
 
+/*!
+ * @brief   Snapshot of the statistics of an arena, see BasicAllocation::stats().
+ *          All the fields are 0 unless the library is built with
+ *          CUS_ALLOCATOR_STATS defined, so they cost nothing otherwise.
+ */
+struct AllocationStats {
+    // Calls which succeeded and calls which failed
+    arch_t allocations;
+    arch_t allocationFailures;
+    arch_t reallocations;
+    arch_t reallocationFailures;
+    arch_t deallocations;
+    arch_t deallocationFailures;
+    // removeElement() and removeRange()
+    arch_t removals;
+    arch_t removalFailures;
+    // Complete compactions, and calls to compactStep()
+    arch_t compactions;
+    arch_t compactionSteps;
+    // Bytes of data moved to make room for a growth, to close the gap of
+    // removed bytes (deallocate() and shrinking reallocate() included) and
+    // by the compactions
+    arch_t reallocationBytesMoved;
+    arch_t removalBytesMoved;
+    arch_t compactionBytesMoved;
+    // Lookups of an object by the changes, and entries of the address area
+    // or slots of the index visited by them. Readers which do not lock, as
+    // sizeElement(), are not counted
+    arch_t lookups;
+    arch_t lookupScanned;
+    // Highest bytes of data and of addresses in use
+    arch_t highWaterData;
+    arch_t highWaterAddresses;
+    // CrcAllocation only: bytes processed by the CRCs, blocks restored from
+    // the other copy and blocks with both copies corrupted
+    arch_t crcBytes;
+    arch_t crcRestores;
+    arch_t crcFailures;
+};
+
+/*!
+ * @brief   Object of the address area, see BasicAllocation::exportMap()
+ */
+struct MapEntry {
+    // Bytes from the start of the data area
+    arch_t dataOffset;
+    arch_t size;
+    // Address of the pointer to the object, 0 if it is dead
+    arch_t requester;
+    bool pinned;
+    // Deallocated in deferred mode, its bytes wait for a compaction
+    bool dead;
+};
+
+/*!
+ * @brief   Occupancy of an arena, see BasicAllocation::exportMap()
+ */
+struct MapSummary {
+    // Data and address areas, the index excluded
+    arch_t arenaBytes;
+    // Bytes used by the data, up to the end of the last object
+    arch_t dataBytes;
+    arch_t tableBytes;
+    // Entries of the address area, dead ones included
+    arch_t objects;
+    arch_t liveBytes;
+    arch_t deadBytes;
+    // Holes in the data, left before the pinned and the aligned objects
+    arch_t gapBytes;
+    // Bytes between the data and the address areas, or its reserved space
+    arch_t freeBytes;
+    // Dead and gap bytes over dataBytes, from 0 to 1
+    double fragmentation;
+};
+
+/*!
+ * @brief   Called by exportMap() for every entry, in the order of the data
+ */
+typedef void (*MapVisitor)(const MapEntry& entry, void *context);
+
+/*!
+ * @brief   Binary format of BasicAllocation::writeMapBinary(), in words of
+ *          arch_t with the byte order of the host:
+ *            - MAP_MAGIC in the low 32 bits and MAP_VERSION in the high ones
+ *            - arenaBytes, dataBytes, tableBytes and objects of MapSummary
+ *            - Bytes reserved for the address area, 0 if it grows with the
+ *              entries, so freeBytes is arenaBytes - dataBytes - the largest
+ *              of both table sizes
+ *            - For every object: dataOffset, size with MAP_PINNED set if it
+ *              is pinned, and requester, which is 0 for dead objects
+ *          Snapshots can be appended one after another in the same file.
+ */
+constexpr uint32_t MAP_MAGIC = 0x4D535543; // "CUSM"
+constexpr uint32_t MAP_VERSION = 1;
+constexpr arch_t MAP_HEADER_WORDS = 6;
+constexpr arch_t MAP_ENTRY_WORDS = 3;
+constexpr arch_t MAP_PINNED = ((arch_t)1) << 63;
+
+/*!
+ * @brief   Log bucketed histogram of latencies in nanoseconds, as HDR
+ *          histograms. Every power of two is split in SUB_BUCKETS buckets,
+ *          so values are kept with a relative error below 1/SUB_BUCKETS,
+ *          and values below SUB_BUCKETS are exact.
+ */
+class LatencyHistogram {
+    public:
+        static constexpr uint32_t SUB_BITS = 3;
+        static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BITS;
+        // Up to 2^40 ns, around 18 minutes. Longer values go to the last one
+        static constexpr uint32_t MAGNITUDES = 40;
+        static constexpr uint32_t BUCKETS = (MAGNITUDES - SUB_BITS + 1)*SUB_BUCKETS;
+
+        LatencyHistogram();
+        void record(arch_t nanoseconds);
+        void reset();
+        arch_t count() const;
+        arch_t min() const;
+        arch_t max() const;
+        /*!
+         * @brief   Latency under which percentage of the values are
+         * @param   percentage From 0 to 100
+         * @return  Highest value of the bucket of that percentile, limited to
+         *          max(). 0 if nothing was recorded
+         */
+        arch_t percentile(double percentage) const;
+        static uint32_t bucketOf(arch_t value);
+        static arch_t highestOf(uint32_t bucket);
+    private:
+        arch_t buckets[BUCKETS];
+        arch_t total;
+        arch_t lowest;
+        arch_t highest;
+};
+
 class MathArch {
     public:
+        /*!
+         * @brief   Polynomials supported by crc32. CRC32C is computed with the
+         *          SSE4.2 crc32 instruction when the CPU provides it
+         */
+        enum crcPolynomial {
+            CRC32_IEEE=0,
+            CRC32C=1
+        };
+        MathArch();
         arch_t roundUp(arch_t numToRound, uint32_t multiple);
+        /*!
+         * @brief   CRC of the bytes in [start, end)
+         */
         uint32_t crc32(const void *start, const void *end);
+        /*!
+         * @brief   It selects the polynomial used by crc32. CRC32C by default
+         * @note    Stored CRCs are not recalculated, so for a CrcAllocation
+         *          updateMirror() has to be called after changing it
+         */
+        void setCrcPolynomial(crcPolynomial poly);
+    protected:
+        /*!
+         * @brief   CRC register update without initial and final inversion
+         */
+        uint32_t crc32Raw(uint32_t crc, const void *start, size_t len);
+        /*!
+         * @brief   It advances a raw CRC register over zeros bytes set to 0
+         *          in O(log(zeros))
+         */
+        uint32_t crc32Shift(uint32_t crc, arch_t zeros);
+
+        crcPolynomial polynomial;
 };
 
-class BasicAllocation: public MathArch, public MemoryMgmt {
+/*!
+ * @brief   Interface of the arenas used by the containers, so a Container
+ *          can be backed by a BasicAllocation or a PoolAllocation. The
+ *          requester is always the pointer of the container to its memory,
+ *          Container::aMem, which the arena updates when the object moves.
+ */
+class Allocator: public MemoryMgmt {
     public:
+        virtual ~Allocator() {}
+        virtual bool allocate(arch_t addrRequester, void*& requester, \
+                std::size_t nBytes)=0;
+        /*!
+         * @brief   As allocate(), with the data at an address multiple of
+         *          alignment, a power of two, while the object lives
+         */
+        virtual bool allocateAligned(arch_t addrRequester, void*& requester, \
+                std::size_t nBytes, std::size_t alignment)=0;
+        virtual bool reallocate(void*& requester, std::size_t pBytes, \
+                std::size_t nBytes)=0;
+        virtual bool deallocate(arch_t addrRequester)=0;
+        virtual uint32_t sizeElement(void*& requester)=0;
+        /*!
+         * @brief   It removes count bytes of an object from the offset first,
+         *          moving the rest of the object down
+         */
+        virtual bool removeRange(arch_t addrRequester, std::size_t first, \
+                std::size_t count)=0;
+        /*!
+         * @brief   Written bytes, for the arenas which mirror them
+         */
+        virtual void markDirty(const void *from, size_t len) { (void)from; (void)len; }
+};
+
+class BasicAllocation: public MathArch, public Allocator {
+    public:
+        /*!
+         * @brief   It moves nBytes of an object from from to to. Both areas
+         *          can overlap, see Relocation
+         */
+        typedef void (*Relocator)(void *to, void *from, std::size_t nBytes);
+        static constexpr uint32_t RELOCATORS = 7;
+        /*!
+         * @brief   Largest alignment which allocateAligned() keeps
+         */
+        static constexpr std::size_t MAX_ALIGNMENT = 128;
         /*!
          * @brief   Constructor to cover a new area of memory
          * @param   startSection pointer to the starting address of the reserved
@@ -87,6 +302,23 @@ class BasicAllocation: public MathArch, public MemoryMgmt {
          *          area of memory
          */
         BasicAllocation(const void *startSection, const void *endSection);
+        /*!
+         * @brief   Constructor to cover a new area of memory with indexed
+         *          lookups. The top of the section is reserved for a hash
+         *          table which maps every requester to its entry in the
+         *          address area, so deallocate, removeElement and reallocate
+         *          find the object in O(1) instead of scanning the addresses.
+         * @param   startSection pointer to the starting address of the reserved
+         *          area of memory
+         * @param   endSection pointer to the ending address of the reserved
+         *          area of memory
+         * @param   indexedObjects maximum number of objects the arena will
+         *          hold. It costs 4 * sizeof(arch_t) bytes per object (rounded
+         *          up to a power of two)
+         * @note    In this mode the same requester cannot be allocated twice
+         */
+        BasicAllocation(const void *startSection, const void *endSection, \
+                uint32_t indexedObjects);
         /*!
          * @brief   Copy constructor not allowed
          */
@@ -103,6 +335,7 @@ class BasicAllocation: public MathArch, public MemoryMgmt {
          * @brief   Move operator not allowed
          */
         BasicAllocation& operator=(BasicAllocation&&) = delete;
+        virtual ~BasicAllocation();
         /*!
          * @brief   It is the way an object requests reserved space for itself.
          * @param   requester It is the address of the pointer which will
@@ -113,6 +346,16 @@ class BasicAllocation: public MathArch, public MemoryMgmt {
          * @return  True if the allocation was valid. Otherwise, False
          */
         bool allocate(arch_t addrRequester, void*& requester,std::size_t nBytes);
+        /*!
+         * @brief   Same as allocate(), but the data is placed at an address
+         *          multiple of alignment. The arena keeps it when the object
+         *          moves, so the bytes before it can be left free after a
+         *          compaction, a removal or the growth of a previous object.
+         * @param   alignment Power of two, up to MAX_ALIGNMENT
+         * @return  True if the allocation was valid. Otherwise, False
+         */
+        bool allocateAligned(arch_t addrRequester, void*& requester, \
+                std::size_t nBytes, std::size_t alignment);
         /*!
          * @brief   It allows to resize the previously allocated memory for an
          *          object.
@@ -124,9 +367,22 @@ class BasicAllocation: public MathArch, public MemoryMgmt {
          *          objects, so avoid it if there are time constrictions.
          *          Check the objects which doesn't dinamically reallocate
          *          memory.
+         *          Free space between the object and the next one is used
+         *          first, and the last object grows without moving others.
+         *          When nBytes is lower than pBytes, only the size of the
+         *          object changes. The last bytes are left as slack, which
+         *          a later growth reuses in place, and the next objects do
+         *          not move until a compaction. It can not be 0, see
+         *          deallocate(). A growth which does not fit compacts the
+         *          arena first if there is slack or deallocated objects.
          * @return  True if the reallocation was valid, Otherwise, False.
          */
         bool reallocate(void*& requester,std::size_t pBytes, std::size_t nBytes);
+        /*!
+         * @brief   It provides the number of reallocations which did not move
+         *          any other object
+         */
+        arch_t reallocationsInPlace();
         /*!
          * @brief   It wipes the reserved memory for an object and all its
          *          references.
@@ -149,6 +405,18 @@ class BasicAllocation: public MathArch, public MemoryMgmt {
          * @return  True if the reallocation was valid, Otherwise, False.
          */
         bool removeElement(arch_t addrRequester, void * posElement, size_t size);
+        /*!
+         * @brief   It removes count bytes of an object, from the offset first.
+         *          The rest of the object and the next objects move only once,
+         *          whatever the number of bytes.
+         * @param   addrRequester It is the address of the pointer which points
+         *          to the reserved area of memory
+         * @param   first Offset of the first byte to remove
+         * @param   count Number of bytes to remove. If it covers the whole
+         *          object, the object is deallocated
+         * @return  True if the range is within the object, Otherwise, False.
+         */
+        bool removeRange(arch_t addrRequester, std::size_t first, std::size_t count);
         /*!
          * @brief   It provides the number of allocated elements
          */
@@ -181,30 +449,347 @@ class BasicAllocation: public MathArch, public MemoryMgmt {
          */
         bool checkConsistency();
         /*!
-         * @brief   Debugging purposes
+         * @brief   It notifies that an area of the arena was written.
+         *          Only allocators which mirror the arena keep track of it,
+         *          see CrcAllocation::updateDirtyMirror()
+         * @param   from First written byte
+         * @param   len Number of written bytes
+         */
+        virtual void markDirty(const void *from, size_t len);
+        /*!
+         * @brief   It allows to share the arena between threads. Changes are
+         *          serialized. elements(), sizeElement(), isPinned() and the
+         *          exports of the map do not lock, they repeat the read if
+         *          a change happened meanwhile.
+         * @param   enable True to serialize the changes
+         * @note    It has to be set before the arena is shared. Turning it
+         *          off waits for the change which holds the lock. Writing
+         *          the data of the objects is not synchronized, only the
+         *          allocator itself.
+         */
+        void setThreadSafe(bool enable);
+        /*!
+         * @brief   In this mode, deallocate() only marks the object as
+         *          deallocated, without moving the next objects, so it does
+         *          not depend on the size of the arena. The space is
+         *          recovered by compact(), which is also called when the
+         *          deallocated bytes reach the compaction threshold or when
+         *          an allocation does not fit.
+         * @param   enable True to defer the compaction. When disabled, the
+         *          arena is compacted.
+         */
+        void setDeferredFree(bool enable);
+        /*!
+         * @brief   Percentage of the data area which has to be deallocated
+         *          for deallocate() to compact the arena. 50 by default.
+         * @param   percentage From 0 (compact on every deallocation) to 100
+         *          (compact only when everything was deallocated). Above 100,
+         *          only compact() and the allocations which do not fit
+         *          compact the arena.
+         */
+        void setCompactionThreshold(uint32_t percentage);
+        /*!
+         * @brief   It moves all the objects together, recovering the space of
+         *          the objects deallocated in deferred mode.
+         * @note    It rewrites the pointers of the moved objects, so call it
+         *          when there are no time constrictions.
+         */
+        void compact();
+        /*!
+         * @brief   Bounded part of compact(). It moves objects to the start of
+         *          the arena until budget bytes are spent, and the next call
+         *          continues from there. Between calls, the arena can be used
+         *          as usual.
+         * @param   budget Bytes of data and addresses to rewrite. At least
+         *          one object is processed, so the step can be longer for
+         *          objects bigger than the budget.
+         * @note    allocate() and deallocate() keep the progress. Other
+         *          changes start it again from the first object.
+         * @return  True if the arena is compacted. Otherwise, False.
+         */
+        bool compactStep(arch_t budget);
+        /*!
+         * @brief   It provides the bytes of the deallocated objects and the
+         *          slack of the shrunk objects which are waiting for a
+         *          compaction
+         */
+        arch_t releasedBytes();
+        /*!
+         * @brief   The data of the object keeps its address until unpin(), so
+         *          pointers to it can be kept between calls. The objects
+         *          between two pinned ones are moved as usual, but only
+         *          within the free space between them.
+         * @param   addrRequester It is the address of the pointer which points
+         *          to the reserved area of memory
+         * @note    Growing an object before a pinned one fails if the objects
+         *          in the middle do not fit before it. Deallocating the
+         *          object also unpins it.
+         * @return  True if the object was found. Otherwise, False.
+         */
+        bool pin(arch_t addrRequester);
+        /*!
+         * @brief   The object can be moved again, see pin()
+         * @return  True if the object was found. Otherwise, False.
+         */
+        bool unpin(arch_t addrRequester);
+        /*!
+         * @brief   It provides if the object is pinned, see pin()
+         */
+        bool isPinned(arch_t addrRequester);
+        /*!
+         * @brief   It sets how the data of the object is moved when the arena
+         *          moves it, so objects which can not be copied byte by byte
+         *          can be allocated. Relocation<T>::attach() sets it for an
+         *          array of T.
+         * @param   addrRequester It is the address of the pointer which points
+         *          to the reserved area of memory
+         * @param   relocator Function to move the data. nullptr moves the
+         *          bytes, which is the default and the fastest way
+         * @note    Up to RELOCATORS different functions per arena. The data
+         *          has to be aligned for the type, see allocateAligned().
+         * @return  True if the object was found and the function could be
+         *          registered. Otherwise, False.
+         */
+        bool setRelocator(arch_t addrRequester, Relocator relocator);
+        /*!
+         * @brief   True if the statistics are recorded, see AllocationStats
+         */
+#ifdef CUS_ALLOCATOR_STATS
+        static constexpr bool STATS_ENABLED = true;
+#else
+        static constexpr bool STATS_ENABLED = false;
+#endif
+        /*!
+         * @brief   Copy of the statistics since the construction or the last
+         *          resetStats(). It does not lock, so the fields might belong
+         *          to different instants if other threads use the arena
+         */
+        AllocationStats stats();
+        void resetStats();
+        /*!
+         * @brief   Operations with their own latency histogram. Removals are
+         *          removeElement() and removeRange(), and the mirror updates
+         *          include updateDirtyMirror()
+         */
+        enum latencyOperation {
+            LATENCY_ALLOCATE=0,
+            LATENCY_REALLOCATE=1,
+            LATENCY_DEALLOCATE=2,
+            LATENCY_REMOVE_ELEMENT=3,
+            LATENCY_UPDATE_MIRROR=4,
+            LATENCY_CHECK_CONSISTENCY=5,
+            LATENCY_OPERATIONS=6
+        };
+        /*!
+         * @brief   True if the latencies can be recorded, which needs the
+         *          library built with CUS_ALLOCATOR_LATENCY defined. The
+         *          histograms are not part of the object, see enableLatency()
+         */
+#ifdef CUS_ALLOCATOR_LATENCY
+        static constexpr bool LATENCY_ENABLED = true;
+#else
+        static constexpr bool LATENCY_ENABLED = false;
+#endif
+        /*!
+         * @brief   Records the latencies in histograms, LATENCY_OPERATIONS of
+         *          them owned by the caller while they are in use. nullptr,
+         *          the default, stops the recording
+         */
+        void enableLatency(LatencyHistogram *histograms);
+        /*!
+         * @brief   Copy of the histogram of an operation since
+         *          enableLatency() or the last resetLatency(). Empty if the
+         *          latencies are not recorded
+         */
+        LatencyHistogram latency(latencyOperation operation);
+        void resetLatency();
+        /*!
+         * @brief   It goes through the address area in the order of the data.
+         *          It does not lock: if another thread changes the arena
+         *          meanwhile, the walk starts again from the first object
+         * @param   visitor Called for every object, again after a restart.
+         *          It can not call the arena
+         * @param   context Passed to visitor as it is
+         * @return  Occupancy and fragmentation of the arena
+         */
+        MapSummary exportMap(MapVisitor visitor = nullptr, void *context = nullptr);
+        /*!
+         * @brief   It writes the map as a JSON object in a single line, so
+         *          periodic snapshots can be stored as JSON lines
+         */
+        void writeMapJson(std::ostream& out);
+        /*!
+         * @brief   It writes the map in the format of MAP_MAGIC
+         */
+        void writeMapBinary(std::ostream& out);
+        /*!
+         * @brief   Debugging purposes. writeMapJson() to stdout
          */
         void showMap();
   protected:
+        // Serializes a change in thread safe mode. It can be nested
+        class MutationGuard {
+            public:
+                explicit MutationGuard(BasicAllocation& section);
+                ~MutationGuard();
+                MutationGuard(const MutationGuard&) = delete;
+                MutationGuard& operator=(const MutationGuard&) = delete;
+            private:
+                BasicAllocation& owner;
+                bool locked;
+        };
+
         BasicAllocation();
-        void removeFromAddresses(uint32_t indexToDelete, void * element, size_t size);
+        // Layout computed by the caller, see StaticArena: the index of
+        // slots pairs ends the arena and tableBytes under it are reserved
+        // for the address area
+        BasicAllocation(const void *startSection, arch_t *index, arch_t slots, \
+                uint32_t indexedObjects, arch_t tableBytes);
+        // keepSlack leaves the freed bytes after a shrunk object instead of
+        // moving the next objects down
+        void removeFromAddresses(uint32_t indexToDelete, void * element, size_t size, \
+                bool keepSlack);
         void shrinkData();
+        void resetCompaction();
+        arch_t entrySize(sarch_t idx);
+        bool entryPinned(sarch_t idx);
+        static arch_t sizeAlignment(arch_t sizeWord);
+        // Bytes the address area takes with addresses words, see reservedTable
+        arch_t tableSpace(arch_t addresses);
+        sarch_t nextPinned(sarch_t idx);
+        void relocateData(arch_t sizeWord, void *to, void *from, std::size_t nBytes);
+        // record is false for the readers without lock, see STAT_LOOKUP
+        sarch_t findRequester(arch_t addrRequester, bool record = true);
+        sarch_t findData(void*& requester, bool record = true);
+        arch_t indexSlot(arch_t key);
+        sarch_t indexFind(arch_t key, bool record = true);
+        bool indexInsert(arch_t key, arch_t idx);
+        void indexUpdate(arch_t key, arch_t idx);
+        void indexErase(arch_t key);
+        uint32_t readBegin();
+        bool readRetry(uint32_t sequenceBegin);
+        void writeBegin();
+        void writeEnd();
+        // The words which the readers of the sequence can see, the table,
+        // the index, the counters and the pointers of the requesters, are
+        // accessed with relaxed atomics on both sides
+        template <typename W>
+        static W loadWord(const W& word) {
+            return __atomic_load_n(&word, __ATOMIC_RELAXED);
+        }
+        template <typename W>
+        static void storeWord(W& word, typename std::common_type<W>::type value) {
+            __atomic_store_n(&word, value, __ATOMIC_RELAXED);
+        }
+        // One walk of exportMap(), the caller handles the retries
+        MapSummary scanMap(MapVisitor visitor, void *context);
 
         arch_t sizeArena;
         arch_t *start;
         arch_t *end;
         arch_t lastData;
         arch_t lastAddr;
-        std::mutex allocator_mutex;
+        // Bytes under end kept for the address area, which the data never
+        // uses, and the most it can take. 0 when both share the free space
+        arch_t reservedTable = 0;
+        // Open addressing table of (requester, index) pairs. Disabled when
+        // indexSlots is 0
+        arch_t *indexTable = nullptr;
+        arch_t indexSlots = 0;
+        arch_t indexObjects = 0;
+        std::recursive_mutex allocator_mutex;
+        // Read by every change, it can be set while other threads use the
+        // arena, see ThreadLocalAllocation::donate()
+        std::atomic<bool> threadSafe{false};
+        // Deallocated entries have no requester until the next compaction.
+        // deadBytes also counts the slack left by shrinking objects
+        bool deferredFree = false;
+        uint32_t compactionThreshold = 50;
+        arch_t deadBytes = 0;
+        arch_t deadEntries = 0;
+        // Progress of compactStep(). Entry to process, entries already
+        // together and offset of the data of the next one
+        arch_t compactRead = 0;
+        arch_t compactKept = 0;
+        arch_t compactNext = 0;
+        arch_t reallocatedInPlace = 0;
+        arch_t pinnedEntries = 0;
+        // Largest alignment requested, the padding a change can add before
+        // the moved objects
+        arch_t maxAlignment = 1;
+#ifdef CUS_ALLOCATOR_STATS
+        AllocationStats statistics = {};
+#endif
+#ifdef CUS_ALLOCATOR_LATENCY
+        // Recorded while the change holds the MutationGuard
+        LatencyHistogram *latencies = nullptr;
+#endif
+        // Relocator of the objects with id idx+1 in their DATA_SIZE
+        Relocator relocators[RELOCATORS] = {};
+        // Nested changes and sequence for the readers, odd while changing
+        uint32_t writeDepth = 0;
+        std::atomic<uint32_t> sequence{0};
         enum mapPddress {
             POINTER_TO_DATA=1,
             DATA_SIZE=2,
             POINTER_TO_REQUESTER=3,
             TOTAL_ELEMENTS=3
         };
+        // Flags in the DATA_SIZE: the object is pinned, the id of its
+        // relocator, 0 when the bytes are just moved, and the log2 of the
+        // alignment of its data
+        static constexpr arch_t PINNED_OBJECT = (arch_t)1 << (sizeof(arch_t)*8-1);
+        static constexpr uint32_t RELOCATOR_SHIFT = sizeof(arch_t)*8-4;
+        static constexpr arch_t RELOCATOR_ID = (arch_t)RELOCATORS << RELOCATOR_SHIFT;
+        static constexpr uint32_t ALIGNMENT_SHIFT = sizeof(arch_t)*8-7;
+        static constexpr arch_t ALIGNMENT_LOG = (arch_t)7 << ALIGNMENT_SHIFT;
+        static constexpr arch_t SIZE_FLAGS = PINNED_OBJECT | RELOCATOR_ID | \
+                                             ALIGNMENT_LOG;
+        enum indexMap {
+            INDEX_KEY=0,
+            INDEX_VALUE=1,
+            INDEX_ELEMENTS=2
+        };
 };
 
 
 
+/*!
+ * @brief   Relocation of the arrays of T allocated in a BasicAllocation.
+ *          Trivially copyable types are moved byte by byte, the rest are
+ *          move constructed to the new place and destroyed in the old one.
+ */
+template <typename T>
+class Relocation {
+    public:
+        static constexpr bool trivial = std::is_trivially_copyable<T>::value;
+        /*!
+         * @brief   It moves the nBytes/sizeof(T) elements in from to to.
+         *          The areas can overlap by any number of bytes, so every
+         *          element goes through a temporary
+         */
+        static void relocate(void *to, void *from, std::size_t nBytes) {
+            T *dst = static_cast<T *>(to);
+            T *src = static_cast<T *>(from);
+            std::size_t count = nBytes / sizeof(T);
+            for(std::size_t idx=0;idx<count;idx++) {
+                // Down from the first element, up from the last one
+                std::size_t pos = (dst < src) ? idx : count-1-idx;
+                T temporary(std::move(src[pos]));
+                src[pos].~T();
+                new (&dst[pos]) T(std::move(temporary));
+            }
+        }
+        /*!
+         * @brief   It sets the relocator of an object which is an array of T
+         * @return  See BasicAllocation::setRelocator()
+         */
+        static bool attach(BasicAllocation& section, arch_t addrRequester) {
+            return section.setRelocator(addrRequester, \
+                    trivial ? nullptr : &Relocation<T>::relocate);
+        }
+};
+
 class CrcAllocation: public BasicAllocation {
     public:
         /*!
@@ -215,6 +800,21 @@ class CrcAllocation: public BasicAllocation {
          *          area of memory
          */
         CrcAllocation(const void *startSection, const void *endSection);
+        /*!
+         * @brief   Constructor to cover a new area of memory, where every
+         *          block of blockSize bytes of the arena has its own CRC, so
+         *          checks, updates and restores work per block
+         * @param   startSection pointer to the starting address of the reserved
+         *          area of memory
+         * @param   endSection pointer to the ending address of the reserved
+         *          area of memory
+         * @param   blockSize bytes covered by each CRC. Each block costs
+         *          sizeof(arch_t) bytes in both copies. 0 means a single
+         *          CRC for the whole arena. Otherwise, it is rounded up to a
+         *          multiple of sizeof(arch_t), with a minimum of 64 bytes
+         */
+        CrcAllocation(const void *startSection, const void *endSection, \
+                uint32_t blockSize);
         /*!
          * @brief   Copy constructor not allowed
          */
@@ -250,15 +850,386 @@ class CrcAllocation: public BasicAllocation {
          *          as corruptede and it will notify it to upper layers
          * @return  True if the consistency is valid or it was able to restore it.
          *          Otherwise, False.
+         * @note    Each block is checked and restored on its own, so
+         *          corruptions in different copies of different blocks can
+         *          be recovered
          */
         bool checkConsistency();
+        /*!
+         * @brief   Same as checkConsistency(), but only for the blocks which
+         *          contain any byte of the area [from, from+len)
+         * @return  True if the consistency is valid or it was able to restore it.
+         *          Otherwise, False.
+         */
+        bool checkConsistency(const void *from, size_t len);
+        /*!
+         * @brief   Same as checkConsistency(), but only for the blocks which a
+         *          change of an object can write: its data from offset, the
+         *          data of the next objects, which move when it grows or
+         *          shrinks, growBytes of free space after them, and the
+         *          address entries from its own one to the next free one.
+         *          The cost depends on the bytes after the change instead of
+         *          the size of the arena.
+         * @param   addrRequester It is the address of the pointer which points
+         *          to the reserved area of memory. An unknown one is checked
+         *          as a new object after the last one
+         * @param   offset First byte of the object written by the change,
+         *          or notified through markDirty(). The removals notify the
+         *          object from its first byte
+         * @param   growBytes Bytes the change can add to the object
+         * @note    With deallocated objects waiting for a compaction, or a
+         *          removal with setDeferredFree() which can reach the
+         *          threshold, every object can move, so the whole data is
+         *          checked.
+         * @return  True if the consistency is valid or it was able to restore it.
+         *          Otherwise, False.
+         */
+        bool checkObject(arch_t addrRequester, arch_t offset, size_t growBytes);
+        /*!
+         * @brief   It keeps track of the written areas of the arena, so
+         *          updateDirtyMirror() only needs to process them.
+         *          The allocator reports its own changes, so only the writes
+         *          of the upper layers have to be notified.
+         * @param   from First written byte
+         * @param   len Number of written bytes
+         */
+        void markDirty(const void *from, size_t len);
+        /*!
+         * @brief   Like updateMirror(), but it only copies the areas notified
+         *          through markDirty() since the last update, and the CRCs
+         *          are updated from the changed bytes, so the cost depends on
+         *          the written bytes instead of the size of the arena.
+         * @note    It expects the mirror of the dirty areas to be valid, so
+         *          checkConsistency() should be called before writing.
+         */
+        void updateDirtyMirror();
+        /*!
+         * @brief   It opens a batch, in which many changes can be done with a
+         *          single check and a single update of the mirror.
+         *          The arena is checked when the first batch is opened. Until
+         *          the last batch is closed, checkConsistency() returns the
+         *          result of that check and updateDirtyMirror() only keeps
+         *          the written areas.
+         * @return  True if the consistency is valid or it was able to restore it.
+         *          Otherwise, False.
+         * @note    Batches can be nested. See CrcBatch.
+         */
+        bool beginBatch();
+        /*!
+         * @brief   It closes a batch. When the last one is closed, the written
+         *          areas are mirrored and the CRCs updated.
+         */
+        void endBatch();
     private:
+        bool checkArea(const void *from, size_t len);
+        bool checkBlocks(arch_t firstBlock, arch_t lastBlock);
+        // It mirrors [from, to) of a single block and updates its CRCs
+        void mirrorDirty(arch_t from, arch_t to);
+        // Change of both CRCs of the block once [from, to) is mirrored
+        uint32_t dirtyDelta(arch_t from, arch_t to);
+        // True if both copies of [from, to) agree out of the dirty ranges
+        bool cleanBytesAgree(arch_t from, arch_t to);
+        // It copies [from, to) of the mirror back to the original
+        void restoreOriginal(arch_t from, arch_t to);
+
+        enum dirtyMap {
+            DIRTY_RANGES=8
+        };
+        enum blockMap {
+            CRC_MIN_BLOCK=64
+        };
         arch_t *startMirror;
         arch_t *endMirror;
         arch_t * startCRC;
         arch_t * startMirrorCRC;
-        uint32_t crcOrig;
-        uint32_t crcMirror;
+        // startCRC and startMirrorCRC hold one CRC per block
+        arch_t crcBlockSize;
+        arch_t crcBlocks;
+        // Offsets from start of the areas pending to be mirrored. The
+        // ranges never overlap
+        arch_t dirtyFrom[DIRTY_RANGES];
+        arch_t dirtyTo[DIRTY_RANGES];
+        uint32_t dirtyRanges;
+        // Nested batches and result of the check when the first was opened
+        uint32_t batchDepth;
+        bool batchConsistent;
+};
+
+/*!
+ * @brief   Scope of a batch of changes in a CrcAllocation. The arena is
+ *          checked when it is created and mirrored when it is destroyed.
+ */
+class CrcBatch {
+    public:
+        /*!
+         * @brief   It opens a batch in the given arena
+         * @param   section arena to be modified in the batch
+         */
+        explicit CrcBatch(CrcAllocation& section);
+        /*!
+         * @brief   It closes the batch
+         */
+        ~CrcBatch();
+        /*!
+         * @brief   Copy constructor not allowed
+         */
+        CrcBatch(const CrcBatch&) = delete;
+        /*!
+         * @brief   Copy operator not allowed
+         */
+        CrcBatch& operator=(const CrcBatch&) = delete;
+        /*!
+         * @brief   Result of the check when the batch was opened
+         * @return  True if the consistency is valid or it was able to restore it.
+         *          Otherwise, False.
+         */
+        bool isConsistent();
+    private:
+        CrcAllocation& arena;
+        bool consistent;
+};
+
+/*!
+ * @brief   Allocator for fixed size objects. Sizes are rounded up to a power
+ *          of two class, and every class keeps a list of the released blocks,
+ *          so allocate and deallocate are O(1). Objects only move when they
+ *          are reallocated to a bigger class, so the pointer of the requester
+ *          does not change otherwise.
+ *          It can share a section with a BasicAllocation, each one covering
+ *          a part of it, and it backs the same containers.
+ * @note    Every block starts with a header of two arch_t, its class and its
+ *          requester, so a block of the 8 bytes class takes 24 bytes. Small
+ *          objects fit better in a BasicAllocation, whose entries take the
+ *          same bytes but do not round the size up.
+ */
+class PoolAllocation: public Allocator {
+    public:
+        /*!
+         * @brief   Constructor to cover a new area of memory
+         * @param   startSection pointer to the starting address of the reserved
+         *          area of memory
+         * @param   endSection pointer to the ending address of the reserved
+         *          area of memory
+         */
+        PoolAllocation(const void *startSection, const void *endSection);
+        /*!
+         * @brief   Copy constructor not allowed
+         */
+        PoolAllocation(const PoolAllocation&) = delete;
+        /*!
+         * @brief   Copy operator not allowed
+         */
+        PoolAllocation& operator=(const PoolAllocation&) = delete;
+        /*!
+         * @brief   Move constructor not allowed
+         */
+        PoolAllocation(PoolAllocation&&) = delete;
+        /*!
+         * @brief   Move operator not allowed
+         */
+        PoolAllocation& operator=(PoolAllocation&&) = delete;
+        /*!
+         * @brief   It is the way an object requests reserved space for itself.
+         * @param   addrRequester It is the address of the pointer which will
+         *          point to the reserved area of memory
+         * @param   requester It is the pointer which will point to the
+         *          reserved area of memory
+         * @param   nBytes Number of bytes to be reserved for the requester. It
+         *          can not be bigger than maxSize()
+         * @return  True if the allocation was valid. Otherwise, False. A
+         *          requester which already owns a block is rejected, it has
+         *          to be deallocated or reallocated instead.
+         */
+        bool allocate(arch_t addrRequester, void*& requester, std::size_t nBytes);
+        /*!
+         * @brief   Same as allocate(). Every block is aligned to arch_t, so
+         *          bigger alignments are rejected
+         */
+        bool allocateAligned(arch_t addrRequester, void*& requester, \
+                std::size_t nBytes, std::size_t alignment);
+        /*!
+         * @brief   It resizes an object. Sizes within its class keep the
+         *          block, bigger ones move the object to a block of their
+         *          class and release the previous one.
+         * @param   requester It is the pointer which points to the reserved
+         *          area of memory
+         * @param   pBytes Size of the object before calling reallocate
+         * @param   nBytes Desired size of the object, up to maxSize()
+         * @return  True if the reallocation was valid, Otherwise, False.
+         */
+        bool reallocate(void*& requester, std::size_t pBytes, std::size_t nBytes);
+        /*!
+         * @brief   It removes count bytes of an object, from the offset first.
+         *          The rest of the block moves down and the block is kept.
+         * @return  True if the range is within the block, Otherwise, False.
+         */
+        bool removeRange(arch_t addrRequester, std::size_t first, std::size_t count);
+        /*!
+         * @brief   It releases the block of an object, so it can be reused by
+         *          objects of the same class
+         * @param   addrRequester It is the address of the pointer which points
+         *          to the reserved area of memory
+         * @return  True if the deallocation was valid, Otherwise, False.
+         */
+        bool deallocate(arch_t addrRequester);
+        /*!
+         * @brief   It provides the number of allocated elements
+         */
+        uint32_t elements();
+        /*!
+         * @brief   It provides the amount of bytes reserved for an element,
+         *          which is the size of its class
+         */
+        uint32_t sizeElement(void*& requester);
+        /*!
+         * @brief   It provides the size of the biggest class
+         */
+        static std::size_t maxSize();
+    private:
+        uint32_t sizeClass(std::size_t nBytes);
+        // Block of an allocated object, nullptr if it does not belong to it
+        arch_t* blockOf(const void *data, arch_t addrRequester);
+        void release(arch_t *block);
+        // It takes a block for the requester, without checking its ownership
+        bool take(arch_t addrRequester, void*& requester, std::size_t nBytes);
+
+        enum poolMap {
+            POOL_MIN_SHIFT=3,
+            POOL_CLASSES=10,
+            HEADER_CLASS=0,
+            HEADER_REQUESTER=1,
+            HEADER_ELEMENTS=2
+        };
+        arch_t *start;
+        arch_t *end;
+        // Next never used byte
+        arch_t *bump;
+        // First released block of every class, each one points to the next
+        arch_t *freeList[POOL_CLASSES];
+        uint32_t objects;
+};
+
+/*!
+ * @brief   Front-end which splits a section in sub arenas of the same size,
+ *          one per thread. The first call of local() from a thread reserves a
+ *          free sub arena, and the objects created by that thread use it
+ *          without any synchronization. When the thread finishes, its sub
+ *          arena is given back, so another thread can use it. Every sub
+ *          arena starts with its BasicAllocation object, SUB_ARENA_OVERHEAD
+ *          bytes which can not hold objects.
+ * @note    The ThreadLocalAllocation has to live longer than the threads
+ *          using it. The containers of a finished thread can still be
+ *          destroyed from other threads, but they can not allocate anymore,
+ *          not even the empty ones: once its sub arena is empty, it can get
+ *          a new owner which uses it without locking.
+ */
+class ThreadLocalAllocation {
+    public:
+        /*!
+         * @brief   Constructor to split a new area of memory
+         * @param   startSection pointer to the starting address of the reserved
+         *          area of memory
+         * @param   endSection pointer to the ending address of the reserved
+         *          area of memory
+         * @param   subArenas number of sub arenas, it is the maximum number of
+         *          threads using the section at the same time. If the section
+         *          has no room for objects after the SUB_ARENA_OVERHEAD of each
+         *          one, no sub arena is created and total() returns 0
+         */
+        ThreadLocalAllocation(const void *startSection, const void *endSection, \
+                uint32_t subArenas);
+        /*!
+         * @brief   Copy constructor not allowed
+         */
+        ThreadLocalAllocation(const ThreadLocalAllocation&) = delete;
+        /*!
+         * @brief   Copy operator not allowed
+         */
+        ThreadLocalAllocation& operator=(const ThreadLocalAllocation&) = delete;
+        /*!
+         * @brief   Move constructor not allowed
+         */
+        ThreadLocalAllocation(ThreadLocalAllocation&&) = delete;
+        /*!
+         * @brief   Move operator not allowed
+         */
+        ThreadLocalAllocation& operator=(ThreadLocalAllocation&&) = delete;
+        /*!
+         * @brief   The sub arenas of the calling thread are dropped. The ones
+         *          of other threads are ignored when those threads finish
+         */
+        ~ThreadLocalAllocation();
+        /*!
+         * @brief   It provides the sub arena of the calling thread, reserving
+         *          one the first time
+         * @return  Sub arena of the thread, or nullptr if all of them are in
+         *          use
+         */
+        BasicAllocation* local();
+        /*!
+         * @brief   It gives the sub arena of the calling thread back before the
+         *          thread finishes. If it still has objects, it is kept
+         *          apart, in thread safe mode so they can be deallocated from
+         *          any thread, and it is reused once it is empty. The new
+         *          owner uses it without synchronization again.
+         */
+        void release();
+        /*!
+         * @brief   It provides the number of sub arenas which can be reserved
+         */
+        uint32_t available();
+        /*!
+         * @brief   It provides the number of sub arenas of the section. If it
+         *          is 0, the section was too small and local() always
+         *          returns nullptr
+         */
+        uint32_t total();
+        /*!
+         * @brief   Bytes of every sub arena taken by its BasicAllocation
+         */
+        static constexpr arch_t SUB_ARENA_OVERHEAD = (sizeof(BasicAllocation) + \
+                sizeof(arch_t) - 1) & ~((arch_t)sizeof(arch_t)-1);
+    private:
+        enum slotState {
+            SLOT_FREE=0,
+            SLOT_OWNED=1,
+            SLOT_ORPHAN=2
+        };
+        enum threadMap {
+            THREAD_ARENAS=8
+        };
+        // Sub arenas reserved by a thread, given back when it finishes.
+        // The generation tells the instance apart from a destroyed one which
+        // was built at the same address
+        class ThreadArenas {
+            public:
+                ~ThreadArenas();
+                void drop(uint32_t idx);
+                ThreadLocalAllocation *registry[THREAD_ARENAS];
+                arch_t generation[THREAD_ARENAS];
+                uint32_t slot[THREAD_ARENAS];
+                uint32_t count=0;
+        };
+        static thread_local ThreadArenas owned;
+        // Instances alive, linked through nextInstance
+        static std::mutex instances_mutex;
+        static ThreadLocalAllocation *instances;
+        static arch_t lastGeneration;
+
+        static bool alive(ThreadLocalAllocation *instance, arch_t generation);
+        sarch_t ownedEntry();
+        BasicAllocation* subArena(uint32_t slot);
+        void donate(uint32_t slot);
+
+        // State of every sub arena, followed by the sub arenas. Each one
+        // starts with its BasicAllocation object
+        arch_t *slots;
+        uint8_t *firstArena;
+        arch_t sizeSubArena;
+        uint32_t subArenas;
+        std::mutex registry_mutex;
+        ThreadLocalAllocation *nextInstance;
+        arch_t generation;
 };
 
 /*!
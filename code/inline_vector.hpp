@@ -0,0 +1,361 @@
+/*!
+ * @file      inline_vector.hpp
+ *
+ * @brief     This file provides a header only variant of cus::Vector. It has
+ *            no virtual members and no list of valid types, so the element
+ *            access and the appends are inlined into the callers, and it
+ *            works for any trivially copyable type. The elements are
+ *            allocated with the alignment of the type, which the arena
+ *            keeps when it moves them, see BasicAllocation::allocateAligned().
+ *
+ * @note      The arena is chosen through a policy instead of a derived class:
+ *              - PlainPolicy works with any Allocator, a BasicAllocation
+ *                or a PoolAllocation
+ *              - CrcPolicy works with a CrcAllocation, checking the blocks
+ *                written by every change before it and updating the mirror
+ *                after it, as cus::CrcVector does
+ *
+ * @date      10 May 2020
+ *
+ * @author    jose.felipe.git@gmail.com
+ *
+ * @version   Revision 1.0.0
+ *
+ * @copyright GPL
+ */
+
+
+#ifndef _CUS_INLINE_VECTOR_HPP_
+#define _CUS_INLINE_VECTOR_HPP_
+
+#include <initializer_list>
+#include <type_traits>
+#include <cstdint>
+#include <cmath>
+#include <cstddef>
+#include "allocator.hpp"
+#include "vector.hpp"
+
+namespace cus {
+
+/*!
+ * @brief   Policy for an arena without mirror. Nothing is checked nor
+ *          notified
+ */
+struct PlainPolicy {
+    typedef Allocator Arena;
+    static bool check(Arena&, const void *, std::size_t) { return true; }
+    static bool checkObject(Arena&, arch_t, arch_t, std::size_t) { return true; }
+    static void written(Arena&, const void *, std::size_t) {}
+    static void update(Arena&) {}
+};
+
+/*!
+ * @brief   Policy for a mirrored arena. The blocks a change can write are
+ *          checked before it, and the written bytes are mirrored after it
+ */
+struct CrcPolicy {
+    typedef CrcAllocation Arena;
+    static bool check(Arena& section, const void *from, std::size_t len) {
+        return section.checkConsistency(from, len);
+    }
+    static bool checkObject(Arena& section, arch_t addrRequester, arch_t offset, \
+            std::size_t growBytes) {
+        return section.checkObject(addrRequester, offset, growBytes);
+    }
+    static void written(Arena& section, const void *from, std::size_t len) {
+        section.CrcAllocation::markDirty(from, len);
+    }
+    static void update(Arena& section) { section.updateDirtyMirror(); }
+};
+
+template <typename T, typename Policy = PlainPolicy>
+class InlineVector {
+    static_assert(std::is_trivially_copyable<T>::value,
+            "Elements are moved byte by byte by the arena");
+    static_assert(alignof(T) <= BasicAllocation::MAX_ALIGNMENT,
+            "The arena can not keep the alignment of the type");
+    typedef typename Policy::Arena Arena;
+    public:
+        /*!
+         * @brief   Constructor to receive just an allocator, without initialisers
+         * @param   section Arena of the type required by the policy
+         */
+        explicit InlineVector(Arena& section) :
+            arena(section), aMem(nullptr), elements(0), capacityElements(0),
+            growthFactor(2.0f), internalFailure(false) {}
+        /*!
+         * @brief   Constructor when receiving an allocator and a list to
+         *          initialise the object
+         * @param   section Arena of the type required by the policy
+         * @param   cList object used to initialise the object
+         */
+        InlineVector(Arena& section, std::initializer_list<T> cList) :
+            InlineVector(section) {
+            append(cList.begin(), cList.size());
+        }
+        /*!
+         * @brief   The arena keeps the address of aMem, so the object can not
+         *          be copied
+         */
+        InlineVector(const InlineVector&) = delete;
+        InlineVector& operator=(const InlineVector&) = delete;
+        /*!
+         * @brief   Destructor to release the memory in the arena
+         */
+        ~InlineVector() {
+            if(aMem != nullptr) {
+                // The next objects move down, as in shrink_to_fit()
+                checkRemoval();
+                arena.deallocate((arch_t)&aMem);
+                Policy::update(arena);
+            }
+        }
+        /*!
+         * @brief   It adds an element at the end. While there is capacity, it
+         *          does not call the arena
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool push_back(const T& value) {
+            if(check(elements, elements + 1)==false) {
+                internalFailure=true;
+            } else if(growTo(elements + 1)==true) {
+                T *slot = (T *)aMem + elements;
+                *slot = value;
+                elements++;
+                Policy::written(arena, slot, sizeof(T));
+                Policy::update(arena);
+            } else {
+                internalFailure=true;
+            }
+
+            return internalFailure;
+        }
+        /*!
+         * @brief   It appends n elements from first at once
+         * @note    first can not point to an object of the same arena, see
+         *          Vector::append(). A range of the object itself is
+         *          rejected
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool append(const T* first, std::size_t n) {
+            if(n == 0) {
+                return internalFailure;
+            }
+            const T *data = (const T *)aMem;
+            if(data != nullptr && first < data + capacityElements && \
+                    first + n > data) {
+                internalFailure=true;
+            } else if(check(elements, elements + n)==false) {
+                internalFailure=true;
+            } else if(growTo(elements + n)==true) {
+                T *slot = (T *)aMem + elements;
+                arena.memcpy2(slot, first, n * sizeof(T));
+                elements += n;
+                Policy::written(arena, slot, n * sizeof(T));
+                Policy::update(arena);
+            } else {
+                internalFailure=true;
+            }
+
+            return internalFailure;
+        }
+        /*!
+         * @brief   It increments the number of elements, as Vector::resize()
+         * @param   newElements amount of elements to increment the object
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool resize(uint32_t newElements) {
+            if(check(elements, elements + newElements)==false || \
+                    growTo(elements + newElements)==false) {
+                internalFailure=true;
+            } else {
+                elements += newElements;
+                Policy::update(arena);
+            }
+
+            return internalFailure;
+        }
+        /*!
+         * @brief   It removes the elements in [first, last) at once. The
+         *          capacity is kept, see shrink_to_fit()
+         */
+        void erase(uint32_t first, uint32_t last) {
+            if(first >= last || last > elements) {
+                return;
+            }
+            if(check(first, elements)==false) {
+                internalFailure=true;
+                return;
+            }
+            T *data = (T *)aMem;
+            std::size_t tail = (elements - last) * sizeof(T);
+            arena.memcpy2(data + first, data + last, tail);
+            Policy::written(arena, data + first, tail);
+            elements -= last - first;
+            Policy::update(arena);
+        }
+        /*!
+         * @brief   It removes a specific element in the object
+         */
+        void erase(uint32_t index) {
+            erase(index, index + 1);
+        }
+        /*!
+         * @brief   It reserves space for at least newCapacity elements
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool reserve(uint32_t newCapacity) {
+            if(check(capacityElements, newCapacity)==false || \
+                    growTo(newCapacity)==false) {
+                internalFailure=true;
+            } else {
+                Policy::update(arena);
+            }
+
+            return internalFailure;
+        }
+        /*!
+         * @brief   It releases the reserved space which is not used by any
+         *          element
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool shrink_to_fit() {
+            if(elements == capacityElements) {
+                return internalFailure;
+            }
+            if(checkRemoval()==false) {
+                internalFailure=true;
+                return internalFailure;
+            }
+            bool validShrink;
+            if(elements == 0) {
+                validShrink = arena.deallocate((arch_t)&aMem);
+                aMem=nullptr;
+            } else {
+                validShrink = arena.removeRange((arch_t)&aMem, \
+                        elements * sizeof(T), \
+                        (capacityElements - elements) * sizeof(T));
+            }
+            if(validShrink==true) {
+                capacityElements = elements;
+                Policy::update(arena);
+            } else {
+                internalFailure=true;
+            }
+
+            return internalFailure;
+        }
+        /*!
+         * @brief   Factor applied to the capacity when it runs out, see
+         *          Vector::setGrowthFactor()
+         */
+        bool setGrowthFactor(float factor) {
+            if(factor > 1.0f && std::isfinite(factor)) {
+                growthFactor=factor;
+                return true;
+            }
+            return false;
+        }
+        std::size_t size() const { return elements; }
+        std::size_t capacity() const { return capacityElements; }
+        bool isJeopardized() const { return internalFailure; }
+        /*!
+         * @brief   Access without boundaries check. Written elements of a
+         *          CrcPolicy vector have to be notified, see Vector::data()
+         */
+        T& operator[](uint32_t index) { return *((T *)aMem + index); }
+        const T& operator[](uint32_t index) const { return *((const T *)aMem + index); }
+        /*!
+         * @brief   Access with boundaries check
+         * @param   outOfBoundaries True if index is not lower than size()
+         */
+        T at(uint32_t index, bool& outOfBoundaries) const {
+            outOfBoundaries = index >= elements;
+            return outOfBoundaries ? T() : *((const T *)aMem + index);
+        }
+        /*!
+         * @brief   Contiguous access, invalidated as Vector::data()
+         */
+        T* data() { return (T *)aMem; }
+        const T* data() const { return (const T *)aMem; }
+        T* begin() { return (T *)aMem; }
+        T* end() { return (T *)aMem + elements; }
+        const T* begin() const { return (const T *)aMem; }
+        const T* end() const { return (const T *)aMem + elements; }
+        Span<T> span() { return Span<T>((T *)aMem, elements); }
+        Span<const T> span() const { return Span<const T>((const T *)aMem, elements); }
+    private:
+        // Blocks written by a change of the elements from pos which needs
+        // minCapacity elements, see CrcVector::checkFrom()
+        bool check(uint32_t pos, uint32_t minCapacity) {
+            if(aMem != nullptr && minCapacity <= capacityElements) {
+                std::size_t n = (minCapacity > pos) ? minCapacity - pos : 0;
+                return Policy::check(arena, (T *)aMem + pos, n * sizeof(T));
+            }
+            // A new object can start after alignof(T)-1 free bytes
+            std::size_t padding = (aMem == nullptr) ? alignof(T) - 1 : 0;
+            return Policy::checkObject(arena, (arch_t)&aMem, pos * sizeof(T), \
+                    growthBytes(minCapacity) + padding);
+        }
+        // The removals notify the whole object and the next ones as written
+        bool checkRemoval() {
+            return Policy::checkObject(arena, (arch_t)&aMem, 0, 0);
+        }
+        std::size_t growthBytes(uint32_t minCapacity) const {
+            if(minCapacity <= capacityElements) {
+                return 0;
+            }
+            uint32_t geometric = geometricCapacity();
+            uint32_t newCapacity = (geometric > minCapacity) ? geometric : minCapacity;
+            return (std::size_t)(newCapacity - capacityElements) * sizeof(T);
+        }
+        // Saturated as Vector::geometricCapacity()
+        uint32_t geometricCapacity() const {
+            double geometric = (double)capacityElements * growthFactor;
+            if(geometric >= (double)UINT32_MAX) {
+                return UINT32_MAX;
+            }
+            return (uint32_t)geometric;
+        }
+        // Same growth as Vector::growTo(), the geometric one first
+        bool growTo(uint32_t minCapacity) {
+            if(minCapacity <= capacityElements) {
+                return true;
+            }
+            return grow(minCapacity);
+        }
+        bool grow(uint32_t minCapacity) {
+            uint32_t geometric = geometricCapacity();
+            uint32_t candidates[2] = {geometric, minCapacity};
+            for(uint32_t newCapacity : candidates) {
+                if(newCapacity < minCapacity) {
+                    continue;
+                }
+                bool validAlloc;
+                if(capacityElements==0) {
+                    validAlloc = arena.allocateAligned((arch_t)&aMem, aMem, \
+                            newCapacity * sizeof(T), alignof(T));
+                } else {
+                    validAlloc = arena.reallocate(aMem, capacityElements * sizeof(T), \
+                            newCapacity * sizeof(T));
+                }
+                if(validAlloc==true) {
+                    capacityElements = newCapacity;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        Arena& arena;
+        void *aMem;
+        uint32_t elements;
+        uint32_t capacityElements;
+        float growthFactor;
+        bool internalFailure;
+};
+
+}; // end namespace
+
+#endif
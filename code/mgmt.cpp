@@ -1,43 +1,227 @@
 
 
-
 #include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include "mgmt.hpp"
 
-void * MemoryMgmt::memcpy2(void *dest, const void *src, size_t len) {
-    if(dest >= src) {
-        char *d = (char *)dest+len;
-        const char *s = (char *)src+len;
-        while (len--) {
-            *--d = *--s;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MGMT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef void (*copyKernel)(uint8_t *d, const uint8_t *s, size_t len);
+
+// Every kernel loads a whole block before storing it, so copying forward is
+// safe when dest < src and copying backward is safe when dest > src
+
+template <bool Invert>
+inline uint8_t invert8(uint8_t value) {
+    return Invert ? (uint8_t)~value : value;
+}
+
+template <bool Invert>
+inline void store64(uint8_t *d, const uint8_t *s) {
+    uint64_t value;
+    std::memcpy(&value, s, sizeof(value));
+    if(Invert) {
+        value = ~value;
+    }
+    std::memcpy(d, &value, sizeof(value));
+}
+
+template <bool Invert>
+void forwardWord(uint8_t *d, const uint8_t *s, size_t len) {
+    while(len && ((uintptr_t)d & (sizeof(uint64_t)-1))) {
+        *d++ = invert8<Invert>(*s++);
+        len--;
+    }
+    while(len >= sizeof(uint64_t)) {
+        store64<Invert>(d, s);
+        d += sizeof(uint64_t);
+        s += sizeof(uint64_t);
+        len -= sizeof(uint64_t);
+    }
+    while(len--) {
+        *d++ = invert8<Invert>(*s++);
+    }
+}
+
+template <bool Invert>
+void backwardWord(uint8_t *d, const uint8_t *s, size_t len) {
+    d += len;
+    s += len;
+    while(len && ((uintptr_t)d & (sizeof(uint64_t)-1))) {
+        *--d = invert8<Invert>(*--s);
+        len--;
+    }
+    while(len >= sizeof(uint64_t)) {
+        d -= sizeof(uint64_t);
+        s -= sizeof(uint64_t);
+        store64<Invert>(d, s);
+        len -= sizeof(uint64_t);
+    }
+    while(len--) {
+        *--d = invert8<Invert>(*--s);
+    }
+}
+
+#ifdef MGMT_X86_KERNELS
+
+template <bool Invert>
+inline __m128i invert128(__m128i value) {
+    return Invert ? _mm_xor_si128(value, _mm_set1_epi32(-1)) : value;
+}
+
+template <bool Invert>
+__attribute__((target("sse2")))
+void forwardSse2(uint8_t *d, const uint8_t *s, size_t len) {
+    const size_t BLOCK = 4*sizeof(__m128i);
+    while(len >= BLOCK) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s+16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s+32));
+        __m128i e = _mm_loadu_si128((const __m128i *)(s+48));
+        _mm_storeu_si128((__m128i *)(d), invert128<Invert>(a));
+        _mm_storeu_si128((__m128i *)(d+16), invert128<Invert>(b));
+        _mm_storeu_si128((__m128i *)(d+32), invert128<Invert>(c));
+        _mm_storeu_si128((__m128i *)(d+48), invert128<Invert>(e));
+        d += BLOCK;
+        s += BLOCK;
+        len -= BLOCK;
+    }
+    forwardWord<Invert>(d, s, len);
+}
+
+template <bool Invert>
+__attribute__((target("sse2")))
+void backwardSse2(uint8_t *d, const uint8_t *s, size_t len) {
+    const size_t BLOCK = 4*sizeof(__m128i);
+    uint8_t *dEnd = d + len;
+    const uint8_t *sEnd = s + len;
+    while(len >= BLOCK) {
+        dEnd -= BLOCK;
+        sEnd -= BLOCK;
+        __m128i a = _mm_loadu_si128((const __m128i *)(sEnd));
+        __m128i b = _mm_loadu_si128((const __m128i *)(sEnd+16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(sEnd+32));
+        __m128i e = _mm_loadu_si128((const __m128i *)(sEnd+48));
+        _mm_storeu_si128((__m128i *)(dEnd), invert128<Invert>(a));
+        _mm_storeu_si128((__m128i *)(dEnd+16), invert128<Invert>(b));
+        _mm_storeu_si128((__m128i *)(dEnd+32), invert128<Invert>(c));
+        _mm_storeu_si128((__m128i *)(dEnd+48), invert128<Invert>(e));
+        len -= BLOCK;
+    }
+    backwardWord<Invert>(d, s, len);
+}
+
+template <bool Invert>
+__attribute__((target("avx2")))
+inline __m256i invert256(__m256i value) {
+    return Invert ? _mm256_xor_si256(value, _mm256_set1_epi32(-1)) : value;
+}
+
+template <bool Invert>
+__attribute__((target("avx2")))
+void forwardAvx2(uint8_t *d, const uint8_t *s, size_t len) {
+    const size_t BLOCK = 4*sizeof(__m256i);
+    while(len >= BLOCK) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s+32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(s+64));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(s+96));
+        _mm256_storeu_si256((__m256i *)(d), invert256<Invert>(a));
+        _mm256_storeu_si256((__m256i *)(d+32), invert256<Invert>(b));
+        _mm256_storeu_si256((__m256i *)(d+64), invert256<Invert>(c));
+        _mm256_storeu_si256((__m256i *)(d+96), invert256<Invert>(e));
+        d += BLOCK;
+        s += BLOCK;
+        len -= BLOCK;
+    }
+    forwardWord<Invert>(d, s, len);
+}
+
+template <bool Invert>
+__attribute__((target("avx2")))
+void backwardAvx2(uint8_t *d, const uint8_t *s, size_t len) {
+    const size_t BLOCK = 4*sizeof(__m256i);
+    uint8_t *dEnd = d + len;
+    const uint8_t *sEnd = s + len;
+    while(len >= BLOCK) {
+        dEnd -= BLOCK;
+        sEnd -= BLOCK;
+        __m256i a = _mm256_loadu_si256((const __m256i *)(sEnd));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(sEnd+32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(sEnd+64));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(sEnd+96));
+        _mm256_storeu_si256((__m256i *)(dEnd), invert256<Invert>(a));
+        _mm256_storeu_si256((__m256i *)(dEnd+32), invert256<Invert>(b));
+        _mm256_storeu_si256((__m256i *)(dEnd+64), invert256<Invert>(c));
+        _mm256_storeu_si256((__m256i *)(dEnd+96), invert256<Invert>(e));
+        len -= BLOCK;
+    }
+    backwardWord<Invert>(d, s, len);
+}
+
+#endif
+
+struct Kernels {
+    copyKernel forward;
+    copyKernel backward;
+    copyKernel forwardMirror;
+    copyKernel backwardMirror;
+
+    Kernels() {
+        forward = forwardWord<false>;
+        backward = backwardWord<false>;
+        forwardMirror = forwardWord<true>;
+        backwardMirror = backwardWord<true>;
+#ifdef MGMT_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            forward = forwardAvx2<false>;
+            backward = backwardAvx2<false>;
+            forwardMirror = forwardAvx2<true>;
+            backwardMirror = backwardAvx2<true>;
+        } else if(__builtin_cpu_supports("sse2")) {
+            forward = forwardSse2<false>;
+            backward = backwardSse2<false>;
+            forwardMirror = forwardSse2<true>;
+            backwardMirror = backwardSse2<true>;
         }
-        return (void *)dest;
+#endif
+    }
+};
+
+const Kernels& kernels() {
+    static const Kernels selected;
+    return selected;
+}
+
+} // end namespace
+
+void * MemoryMgmt::memcpy2(void *dest, const void *src, size_t len) {
+    if(dest == src || len == 0) {
+        return dest;
+    }
+    if(dest > src) {
+        kernels().backward((uint8_t *)dest, (const uint8_t *)src, len);
     } else {
-        char *d = (char *)dest;
-        const char *s = (char *)src;
-        while (len--) {
-            *d++ = *s++;
-        }
-        return (void *)dest;
+        kernels().forward((uint8_t *)dest, (const uint8_t *)src, len);
     }
+    return dest;
 }
 
 void * MemoryMgmt::memcpyMirror(void *dest, const void *src, size_t len) {
-    if(dest >= src) {
-        char *d = (char *)dest;
-        const char *s = (char *)src;
-        while (len--)
-            *d++ = ~(*s++);
-        return dest;
+    if(dest > src) {
+        kernels().backwardMirror((uint8_t *)dest, (const uint8_t *)src, len);
     } else {
-        char *d = (char *)dest+len;
-        const char *s = (char *)src+len;
-        while (len--)
-            *d-- = ~(*s--);
-        return (void *)dest;
+        kernels().forwardMirror((uint8_t *)dest, (const uint8_t *)src, len);
     }
+    return dest;
 }
 
 uint32_t MemoryMgmt::checkMirror(const void *startA, const void *startB, size_t len) {
@@ -53,3 +237,5 @@ uint32_t MemoryMgmt::checkMirror(const void *startA, const void *startB, size_t
 }
 
 
+
+
@@ -1,13 +1,22 @@
-
-
 #ifndef _MEMORY_MGMT_HPP_
 #define _MEMORY_MGMT_HPP_
 
+#include <cstddef>
+#include <cstdint>
 
 
 class MemoryMgmt {
     public:
+        /*!
+         * @brief   Copy of len bytes which supports overlapped areas
+         * @note    It uses AVX2, SSE2 or 64 bits words, depending on the CPU
+         */
         void * memcpy2(void *dest, const void *src, size_t len);
+        /*!
+         * @brief   Bitwise inverted copy of len bytes which supports overlapped
+         *          areas
+         * @note    It uses AVX2, SSE2 or 64 bits words, depending on the CPU
+         */
         void * memcpyMirror(void *dest, const void *src, size_t len);
         uint32_t checkMirror(const void *startA, const void *startB, size_t len);
 };
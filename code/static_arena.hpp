@@ -0,0 +1,123 @@
+/*!
+ * @file      static_arena.hpp
+ *
+ * @brief     This file provides an arena whose size, alignment and number of
+ *            objects are known at compile time. It owns its section, so it
+ *            can be placed as a global or static object. The sizes of its
+ *            layout are computed and checked by the compiler:
+ *              - Data from the start of the section, the address table of
+ *                MaxObjects entries reserved under the index, and the index
+ *                of MaxObjects requesters at the top
+ *              - The data never grows into the table, so the bytes for data
+ *                and the number of entries are fixed
+ *              - Sizes of the objects which can never fit are rejected by
+ *                allocate<N>() at compile time
+ *
+ * @note      The arena is a BasicAllocation with indexed lookups, built on
+ *            the layout given by tableOffset and indexOffset instead of
+ *            computing its own. The reserved table is a limit checked by
+ *            allocate(). It can be used wherever a BasicAllocation is
+ *            expected. Only MaxObjects objects can be allocated at the same
+ *            time.
+ *
+ * @date      10 May 2020
+ *
+ * @author    jose.felipe.git@gmail.com
+ *
+ * @version   Revision 1.0.0
+ *
+ * @copyright GPL
+ */
+
+
+#ifndef _CUS_STATIC_ARENA_HPP_
+#define _CUS_STATIC_ARENA_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include "allocator.hpp"
+
+namespace cus {
+
+/*!
+ * @brief   Storage of a StaticArena. It is a base class, so it exists before
+ *          the BasicAllocation built on it
+ */
+template <std::size_t Bytes, std::size_t Align>
+struct ArenaStorage {
+    alignas(Align) uint8_t section[Bytes];
+};
+
+template <std::size_t Bytes, uint32_t MaxObjects, std::size_t Align = sizeof(arch_t)>
+class StaticArena: private ArenaStorage<Bytes, Align>, public BasicAllocation {
+    public:
+        // Same number of slots as BasicAllocation(start, end, indexedObjects)
+        static constexpr arch_t indexSlotsFor(arch_t objects) {
+            arch_t slots = 1;
+            while(slots < objects*2) {
+                slots <<= 1;
+            }
+            return slots;
+        }
+
+        static constexpr std::size_t bytes = Bytes;
+        static constexpr uint32_t maxObjects = MaxObjects;
+        static constexpr std::size_t alignment = Align;
+        static constexpr std::size_t indexBytes = \
+            indexSlotsFor(MaxObjects)*INDEX_ELEMENTS*sizeof(arch_t);
+        static constexpr std::size_t tableBytes = \
+            (std::size_t)MaxObjects*TOTAL_ELEMENTS*sizeof(arch_t);
+        /*!
+         * @brief   Bytes of data, whatever the number of objects
+         */
+        static constexpr std::size_t dataBytes = Bytes - indexBytes - tableBytes;
+        /*!
+         * @brief   Offsets from storage() of the table and the index. The
+         *          entries grow down from indexOffset to tableOffset
+         */
+        static constexpr std::size_t tableOffset = dataBytes;
+        static constexpr std::size_t indexOffset = Bytes - indexBytes;
+
+        static_assert(MaxObjects != 0, "At least one object is needed");
+        static_assert((Align & (Align-1)) == 0 && Align >= alignof(arch_t),
+                "The address table needs arch_t alignment");
+        static_assert(Bytes % sizeof(arch_t) == 0,
+                "The index is placed at the top of the section");
+        static_assert(Bytes > indexBytes + tableBytes,
+                "The index and the address table do not fit in Bytes");
+
+        /*!
+         * @brief   True if an object of nBytes fits in an empty arena
+         */
+        static constexpr bool fits(std::size_t nBytes) {
+            return nBytes != 0 && nBytes <= dataBytes;
+        }
+
+        // The index ends at the top of the section, so the table ends at
+        // indexOffset, and it keeps the bytes from tableOffset for itself
+        StaticArena() :
+            BasicAllocation(this->section, (arch_t *)(this->section + indexOffset), \
+                    indexSlotsFor(MaxObjects), MaxObjects, indexOffset - tableOffset) {
+        }
+        StaticArena(const StaticArena&) = delete;
+        StaticArena& operator=(const StaticArena&) = delete;
+
+        using BasicAllocation::allocate;
+        /*!
+         * @brief   allocate() of a size known at compile time. Sizes which
+         *          can not fit in the arena do not compile
+         */
+        template <std::size_t N>
+        bool allocate(arch_t addrRequester, void*& requester) {
+            static_assert(fits(N), "The object does not fit in the arena");
+            return BasicAllocation::allocate(addrRequester, requester, N);
+        }
+        /*!
+         * @brief   First byte of the section, aligned to Align
+         */
+        const void* storage() const { return this->section; }
+};
+
+}; // end namespace
+
+#endif
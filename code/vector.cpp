@@ -14,6 +14,7 @@
 
 #include <initializer_list>
 #include <cstdint>
+#include <cmath>
 #include "allocator.hpp"
 #include "vector.hpp"
 
@@ -21,45 +22,119 @@ namespace cus {
 
 template <typename T>
 Vector<T>::Vector(){
-
+    // Derived classes manage the memory with their own arena
+    arena=nullptr;
+    capacityElements=0;
+    growthFactor=2.0f;
 }
 
 template <typename T>
-Vector<T>::Vector(BasicAllocation& section) {
+Vector<T>::Vector(Allocator& section) {
     internalFailure=false;
     arena = &section;
     aMem=nullptr;
     elements=0;
+    capacityElements=0;
+    growthFactor=2.0f;
 }
 
 template <typename T>
-Vector<T>::Vector(BasicAllocation& section,std::initializer_list<T> cList) {
+Vector<T>::Vector(Allocator& section,std::initializer_list<T> cList) {
     internalFailure=false;
     arena = &section;
     aMem=nullptr;
     elements=0;
-    for (T x : cList) {
-        push_back(x);
-    }
+    capacityElements=0;
+    growthFactor=2.0f;
+    append(cList.begin(), cList.size());
 }
 
 template <typename T>
 Vector<T>::~Vector() {
     elements=0;
-    arena->deallocate((arch_t)&aMem);
+    capacityElements=0;
+    if(arena != nullptr) {
+        arena->deallocate((arch_t)&aMem);
+    }
 }
 
 template <typename T>
-bool Vector<T>::push_back(T value) {
+bool Vector<T>::growTo(Allocator *section, uint32_t minCapacity) {
     bool validAlloc = false;
 
-    if(elements==0) {
-        validAlloc = arena->allocate((arch_t)&aMem, aMem,sizeof(T));
-    } else {
-        std::size_t sizeBytes = elements * sizeof(T);
-        validAlloc = arena->reallocate(aMem,sizeBytes,sizeBytes + sizeof(T));
+    if(minCapacity <= capacityElements) {
+        return true;
+    }
+
+    // Try the geometric growth first, and only the needed elements if the
+    // arena is running out of space
+    uint32_t geometric = geometricCapacity();
+    uint32_t candidates[2] = {geometric, minCapacity};
+    for(uint32_t newCapacity : candidates) {
+        if(newCapacity < minCapacity) {
+            continue;
+        }
+        if(capacityElements==0) {
+            validAlloc = section->allocate((arch_t)&aMem, aMem, \
+                    newCapacity * sizeof(T));
+        } else {
+            validAlloc = section->reallocate(aMem, capacityElements * sizeof(T), \
+                    newCapacity * sizeof(T));
+        }
+        if(validAlloc==true) {
+            capacityElements = newCapacity;
+            break;
+        }
     }
 
+    return validAlloc;
+}
+
+template <typename T>
+std::size_t Vector<T>::growthBytes(uint32_t minCapacity) {
+    if(minCapacity <= capacityElements) {
+        return 0;
+    }
+    uint32_t geometric = geometricCapacity();
+    uint32_t newCapacity = (geometric > minCapacity) ? geometric : minCapacity;
+    return (std::size_t)(newCapacity - capacityElements) * sizeof(T);
+}
+
+template <typename T>
+uint32_t Vector<T>::geometricCapacity() {
+    // It saturates, the arena rejects a capacity which does not fit anyway
+    double geometric = (double)capacityElements * growthFactor;
+    if(geometric >= (double)UINT32_MAX) {
+        return UINT32_MAX;
+    }
+    return (uint32_t)geometric;
+}
+
+template <typename T>
+bool Vector<T>::shrinkTo(Allocator *section, uint32_t newCapacity) {
+    bool validShrink = true;
+
+    if(newCapacity < capacityElements) {
+        if(newCapacity==0) {
+            validShrink = section->deallocate((arch_t)&aMem);
+            aMem=nullptr;
+        } else {
+            validShrink = section->removeRange((arch_t)&aMem, \
+                    newCapacity * sizeof(T), \
+                    (capacityElements - newCapacity) * sizeof(T));
+        }
+        if(validShrink==true) {
+            capacityElements = newCapacity;
+        }
+    }
+
+    return validShrink;
+}
+
+template <typename T>
+bool Vector<T>::push_back(T value) {
+    bool validAlloc = growTo(arena, elements + 1);
+
     if(aMem != nullptr && validAlloc==true) {
         *(elements + (T *)aMem) = value;
         elements++;
@@ -72,27 +147,100 @@ bool Vector<T>::push_back(T value) {
 
 template <typename T>
 bool Vector<T>::push_back(Vector<T>& toAppend) {
-    for(uint32_t idx=0;idx<toAppend.size();idx++) {
-        push_back(toAppend[idx]);
+    std::size_t n = toAppend.size();
+    if(n != 0) {
+        // Once reserved, toAppend does not move while copying
+        reserve(elements + n);
+        append(&toAppend[0], n);
     }
 
     return internalFailure;
 }
 
 template <typename T>
-bool Vector<T>::resize(uint32_t newElements) {
-    bool validAlloc = false;
+bool Vector<T>::append(const T* first, std::size_t n) {
+    if(insertRange(arena, elements, first, n)==false) {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
 
+template <typename T>
+bool Vector<T>::insert(uint32_t pos, const T* first, const T* last) {
+    if(pos > elements || insertRange(arena, pos, first, last - first)==false) {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
+
+template <typename T>
+bool Vector<T>::assign(const T* first, const T* last) {
+    if(assignRange(arena, first, last - first)==false) {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
 
-    if(elements==0) {
-        validAlloc = arena->allocate((arch_t)&aMem, aMem,(newElements * sizeof(T)));
+template <typename T>
+bool Vector<T>::assignRange(Allocator *section, const T* first, \
+        std::size_t n) {
+    T *data = (T *)aMem;
+    if(data != nullptr && first >= data && first < data + elements) {
+        // A range of the object itself is not longer than the object, so it
+        // is moved to the front without growing
+        section->memcpy2(data, first, n * sizeof(T));
+        section->markDirty(data, n * sizeof(T));
+        elements = n;
+        return true;
+    }
+    elements=0;
+    return insertRange(section, 0, first, n);
+}
+
+template <typename T>
+bool Vector<T>::insertRange(Allocator *section, uint32_t pos, \
+        const T* first, std::size_t n) {
+    if(n == 0) {
+        return true;
+    }
+    // The range can be part of the object itself, which moves if it grows
+    T *data = (T *)aMem;
+    bool inside = data != nullptr && first >= data && first < data + elements;
+    std::size_t offset = inside ? first - data : 0;
+    if(growTo(section, elements + n)==false || aMem == nullptr) {
+        return false;
+    }
+
+    // The next elements move once and the new ones are copied at once
+    data = (T *)aMem;
+    section->memcpy2(data + pos + n, data + pos, (elements - pos) * sizeof(T));
+    if(inside==false) {
+        section->memcpy2(data + pos, first, n * sizeof(T));
     } else {
-        std::size_t sizeBytes = elements * sizeof(T);
-        validAlloc = arena->reallocate(aMem,sizeBytes,sizeBytes + (newElements*sizeof(T)));
+        // The elements of the range from pos on were moved n positions
+        std::size_t before = (offset < pos) ? pos - offset : 0;
+        if(before > n) {
+            before = n;
+        }
+        section->memcpy2(data + pos, data + offset, before * sizeof(T));
+        section->memcpy2(data + pos + before, data + offset + before + n, \
+                (n - before) * sizeof(T));
     }
+    section->markDirty(data + pos, (elements + n - pos) * sizeof(T));
+    elements += n;
+
+    return true;
+}
+
+template <typename T>
+bool Vector<T>::resize(uint32_t newElements) {
+    bool validAlloc = growTo(arena, elements + newElements);
 
     if(aMem != nullptr && validAlloc==true) {
-        elements++;
+        elements += newElements;
     } else {
         internalFailure=true;
     }
@@ -103,11 +251,7 @@ bool Vector<T>::resize(uint32_t newElements) {
 template <typename T>
 void Vector<T>::erase(uint32_t index) {
     if(index < elements) {
-        bool removed = arena->removeElement((arch_t)&aMem, \
-                                (void *)((T *)aMem + index), sizeof(T));
-        if(removed==true) {
-            elements--;
-        } else {
+        if(eraseRange(arena, index, index + 1)==false) {
             internalFailure=true;
         }
     }
@@ -117,10 +261,7 @@ template <typename T>
 void Vector<T>::erase(uint32_t index, bool& erased) {
     erased=false;
     if(index < elements) {
-        bool removed = arena->removeElement((arch_t)&aMem, \
-                                (void *)((T *)aMem + index), sizeof(T));
-        if(removed==true) {
-            elements--;
+        if(eraseRange(arena, index, index + 1)==true) {
             erased=true;
         } else {
             internalFailure=true;
@@ -128,12 +269,66 @@ void Vector<T>::erase(uint32_t index, bool& erased) {
     }
 }
 
+template <typename T>
+void Vector<T>::erase(uint32_t first, uint32_t last) {
+    if(first < last && last <= elements) {
+        if(eraseRange(arena, first, last)==false) {
+            internalFailure=true;
+        }
+    }
+}
+
+template <typename T>
+bool Vector<T>::eraseRange(Allocator *section, uint32_t first, uint32_t last) {
+    // The next elements move down inside the object, which keeps its
+    // capacity until shrink_to_fit()
+    T *data = (T *)aMem;
+    std::size_t tail = (elements - last) * sizeof(T);
+    section->memcpy2(data + first, data + last, tail);
+    section->markDirty(data + first, tail);
+    elements -= last - first;
+
+    return true;
+}
+
+template <typename T>
+bool Vector<T>::reserve(uint32_t newCapacity) {
+    if(growTo(arena, newCapacity)==false) {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
+
+template <typename T>
+bool Vector<T>::shrink_to_fit() {
+    if(shrinkTo(arena, elements)==false) {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
+
+template <typename T>
+bool Vector<T>::setGrowthFactor(float factor) {
+    // NaN fails the comparison as well
+    if(factor > 1.0f && std::isfinite(factor)) {
+        growthFactor=factor;
+        return true;
+    }
+    return false;
+}
 
 template <typename T>
 std::size_t Vector<T>::size() {
     return elements;
 }
 
+template <typename T>
+std::size_t Vector<T>::capacity() {
+    return capacityElements;
+}
+
 template <typename T>
 bool Vector<T>::isJeopardized() {
     return internalFailure;
@@ -144,6 +339,46 @@ const T& Vector<T>::operator[](uint32_t index) const {
     return *((T *)aMem + index);
 }
 
+template <typename T>
+T* Vector<T>::data() {
+    return (T *)aMem;
+}
+
+template <typename T>
+const T* Vector<T>::data() const {
+    return (const T *)aMem;
+}
+
+template <typename T>
+T* Vector<T>::begin() {
+    return (T *)aMem;
+}
+
+template <typename T>
+T* Vector<T>::end() {
+    return (T *)aMem + elements;
+}
+
+template <typename T>
+const T* Vector<T>::begin() const {
+    return (const T *)aMem;
+}
+
+template <typename T>
+const T* Vector<T>::end() const {
+    return (const T *)aMem + elements;
+}
+
+template <typename T>
+Span<T> Vector<T>::span() {
+    return Span<T>((T *)aMem, elements);
+}
+
+template <typename T>
+Span<const T> Vector<T>::span() const {
+    return Span<const T>((const T *)aMem, elements);
+}
+
 template <typename T>
 T Vector<T>::at(uint32_t index,bool& outOfBoundaries) const {
     if(index<elements) {
@@ -152,6 +387,7 @@ T Vector<T>::at(uint32_t index,bool& outOfBoundaries) const {
     } else {
         outOfBoundaries=true;
     }
+    return T();
 }
 
 
@@ -170,35 +406,53 @@ CrcVector<T>::CrcVector(CrcAllocation& section,std::initializer_list<T> cList) {
     arena = &section;
     aMem=nullptr;
     elements=0;
-    for (T x : cList) {
-        push_back(x);
-    }
+    append(cList.begin(), cList.size());
 }
 
 template <typename T>
 CrcVector<T>::~CrcVector() {
     elements=0;
-    arena->deallocate((arch_t)&aMem);
+    capacityElements=0;
+    if(aMem != nullptr) {
+        // The next objects move down, so they are checked before and
+        // mirrored after, as in shrink_to_fit()
+        checkRemoval();
+        arena->deallocate((arch_t)&aMem);
+        arena->updateDirtyMirror();
+    }
+}
+
+template <typename T>
+bool CrcVector<T>::checkFrom(uint32_t pos, uint32_t minCapacity) {
+    if(aMem != nullptr && minCapacity <= capacityElements) {
+        // Nothing moves
+        std::size_t n = (minCapacity > pos) ? minCapacity - pos : 0;
+        return arena->checkConsistency((T *)aMem + pos, n * sizeof(T));
+    }
+    return arena->checkObject((arch_t)&aMem, pos * sizeof(T), \
+            growthBytes(minCapacity));
+}
+
+template <typename T>
+bool CrcVector<T>::checkRemoval() {
+    // The removals notify the whole object and the next ones as written
+    return arena->checkObject((arch_t)&aMem, 0, 0);
 }
 
 template <typename T>
 bool CrcVector<T>::push_back(T value) {
     bool validAlloc = false;
 
-    bool crcOk = arena->checkConsistency();
+    bool crcOk = checkFrom(elements, elements + 1);
     if(crcOk==true) {
 
-        if(elements==0) {
-            validAlloc = arena->allocate((arch_t)&aMem, aMem,sizeof(T));
-        } else {
-            std::size_t sizeBytes = elements * sizeof(T);
-            validAlloc = arena->reallocate(aMem,sizeBytes,sizeBytes + sizeof(T));
-        }
+        validAlloc = growTo(arena, elements + 1);
 
         if(aMem != nullptr && validAlloc==true) {
             *(elements + (T *)aMem) = value;
+            arena->markDirty((T *)aMem + elements, sizeof(T));
             elements++;
-            arena->updateMirror();
+            arena->updateDirtyMirror();
         } else {
             internalFailure=true;
         }
@@ -213,31 +467,84 @@ bool CrcVector<T>::push_back(T value) {
 
 template <typename T>
 bool CrcVector<T>::push_back(Vector<T>& toAppend) {
-    resize(toAppend.size());
-    for(uint32_t idx=0;idx<toAppend.size();idx++) {
-        push_back(toAppend[idx]);
+    std::size_t n = toAppend.size();
+    if(n != 0) {
+        // Once reserved, toAppend does not move while copying. The arena is
+        // checked and mirrored once for both of them
+        CrcBatch batch(*arena);
+        reserve(elements + n);
+        append(&toAppend[0], n);
     }
 
     return internalFailure;
 }
 
 template <typename T>
-bool CrcVector<T>::resize(uint32_t newElements) {
-    bool validAlloc = false;
+bool CrcVector<T>::append(const T* first, std::size_t n) {
+    return insert(elements, first, first + n);
+}
 
-    bool crcOk = arena->checkConsistency();
+template <typename T>
+bool CrcVector<T>::insert(uint32_t pos, const T* first, const T* last) {
+    if(pos > elements) {
+        internalFailure=true;
+        return internalFailure;
+    }
+
+    // A range of the object itself before pos is checked as well
+    const T *data = (const T *)aMem;
+    uint32_t from = pos;
+    if(data != nullptr && first >= data && first < data + pos) {
+        from = first - data;
+    }
+    bool crcOk = checkFrom(from, elements + (last - first));
     if(crcOk==true) {
+        if(insertRange(arena, pos, first, last - first)==true) {
+            arena->updateDirtyMirror();
+        } else {
+            internalFailure=true;
+        }
+    } else {
+        // This does not have to be an internal failure. The mirror will be used
+        // to workout the jeopardised areas of memory
+        internalFailure=true;
+    }
 
-        if(elements==0) {
-            validAlloc = arena->allocate((arch_t)&aMem, aMem,sizeof(T));
+    return internalFailure;
+}
+
+template <typename T>
+bool CrcVector<T>::assign(const T* first, const T* last) {
+    // A range of the object itself is checked as well
+    std::size_t n = last - first;
+    bool crcOk = checkFrom(0, (n > elements) ? n : elements);
+    if(crcOk==true) {
+        if(assignRange(arena, first, last - first)==true) {
+            arena->updateDirtyMirror();
         } else {
-            std::size_t sizeBytes = elements * sizeof(T);
-            validAlloc = arena->reallocate(aMem,sizeBytes,sizeBytes + sizeof(T));
+            internalFailure=true;
         }
+    } else {
+        // This does not have to be an internal failure. The mirror will be used
+        // to workout the jeopardised areas of memory
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
+
+template <typename T>
+bool CrcVector<T>::resize(uint32_t newElements) {
+    bool validAlloc = false;
+
+    bool crcOk = checkFrom(elements, elements + newElements);
+    if(crcOk==true) {
+
+        validAlloc = growTo(arena, elements + newElements);
 
         if(aMem != nullptr && validAlloc==true) {
-            elements++;
-            arena->updateMirror();
+            elements += newElements;
+            arena->updateDirtyMirror();
         } else {
             internalFailure=true;
         }
@@ -250,16 +557,45 @@ bool CrcVector<T>::resize(uint32_t newElements) {
     return internalFailure;
 }
 
+template <typename T>
+bool CrcVector<T>::reserve(uint32_t newCapacity) {
+    bool crcOk = checkFrom(capacityElements, newCapacity);
+    if(crcOk==true) {
+        if(growTo(arena, newCapacity)==true) {
+            arena->updateDirtyMirror();
+        } else {
+            internalFailure=true;
+        }
+    } else {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
+
+template <typename T>
+bool CrcVector<T>::shrink_to_fit() {
+    bool crcOk = checkRemoval();
+    if(crcOk==true) {
+        if(shrinkTo(arena, elements)==true) {
+            arena->updateDirtyMirror();
+        } else {
+            internalFailure=true;
+        }
+    } else {
+        internalFailure=true;
+    }
+
+    return internalFailure;
+}
+
 template <typename T>
 void CrcVector<T>::erase(uint32_t index) {
     if(index < elements) {
-        bool crcOk = arena->checkConsistency();
+        bool crcOk = checkFrom(index, elements);
         if(crcOk==true) {
-            bool removed = arena->removeElement((arch_t)&aMem, \
-                                    (void *)((T *)aMem + index), sizeof(T));
-            if(removed==true) {
-                elements--;
-                arena->updateMirror();
+            if(eraseRange(arena, index, index + 1)==true) {
+                arena->updateDirtyMirror();
             } else {
                 internalFailure=true;
             }
@@ -275,14 +611,29 @@ template <typename T>
 void CrcVector<T>::erase(uint32_t index, bool& erased) {
     erased=false;
     if(index < elements) {
-        bool crcOk = arena->checkConsistency();
+        bool crcOk = checkFrom(index, elements);
         if(crcOk==true) {
-            bool removed = arena->removeElement((arch_t)&aMem, \
-                                    (void *)((T *)aMem + index), sizeof(T));
-            if(removed==true) {
-                elements--;
+            if(eraseRange(arena, index, index + 1)==true) {
                 erased=true;
-                arena->updateMirror();
+                arena->updateDirtyMirror();
+            } else {
+                internalFailure=true;
+            }
+        } else {
+            // This does not have to be an internal failure. The mirror will be used
+            // to workout the jeopardised areas of memory
+            internalFailure=true;
+        }
+    }
+}
+
+template <typename T>
+void CrcVector<T>::erase(uint32_t first, uint32_t last) {
+    if(first < last && last <= elements) {
+        bool crcOk = checkFrom(first, elements);
+        if(crcOk==true) {
+            if(eraseRange(arena, first, last)==true) {
+                arena->updateDirtyMirror();
             } else {
                 internalFailure=true;
             }
@@ -294,4 +645,27 @@ void CrcVector<T>::erase(uint32_t index, bool& erased) {
     }
 }
 
+// Valid types
+template class  Vector<int16_t>;
+template class  Vector<uint16_t>;
+template class  Vector<unsigned char>;
+template class  Vector<char>;
+template class  Vector<unsigned int>;
+template class  Vector<int>;
+template class  Vector<unsigned long>;
+template class  Vector<long>;
+template class  Vector<float>;
+template class  Vector<double>;
+
+template class  CrcVector<int16_t>;
+template class  CrcVector<uint16_t>;
+template class  CrcVector<unsigned char>;
+template class  CrcVector<char>;
+template class  CrcVector<unsigned int>;
+template class  CrcVector<int>;
+template class  CrcVector<unsigned long>;
+template class  CrcVector<long>;
+template class  CrcVector<float>;
+template class  CrcVector<double>;
+
 }; // end namespace
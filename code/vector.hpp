@@ -26,27 +26,54 @@
 
 #include <initializer_list>
 #include <cstdint>
+#include <cstddef>
 #include "allocator.hpp"
 
 namespace cus {
 
+/*!
+ * @brief   Non owning view of contiguous elements, as std::span
+ * @note    It is invalidated as the pointers of the viewed object, see
+ *          Vector::data()
+ */
+template <typename T>
+class Span {
+    public:
+        Span(T* first, std::size_t count) : ptr(first), count(count) {}
+        T* data() const { return ptr; }
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        T& operator[](std::size_t index) const { return ptr[index]; }
+        T* begin() const { return ptr; }
+        T* end() const { return ptr + count; }
+        /*!
+         * @brief   View of n elements from offset. It can not exceed size()
+         */
+        Span subspan(std::size_t offset, std::size_t n) const {
+            return Span(ptr + offset, n);
+        }
+    private:
+        T* ptr;
+        std::size_t count;
+};
+
 template <typename T>
 class Vector: public Container {
     public:
         /*!
          * @brief   Constructor to receive just an allocator, without initialisers
-         * @param   section Reference of an object of typed BasicAllocation
+         * @param   section Reference of a BasicAllocation or a PoolAllocation
          *          to be used a lower layer to manage the memory
          */
-        explicit Vector(BasicAllocation& section);
+        explicit Vector(Allocator& section);
         /*!
          * @brief   Constructor when receiving an allocator and a list to
          *          initialise the cus::Vector object
-         * @param   section Reference of an object of typed BasicAllocation
+         * @param   section Reference of a BasicAllocation or a PoolAllocation
          *          to be used a lower layer to manage the memory
          * @param   cList object used to initialise the object
          */
-        explicit Vector(BasicAllocation& section,std::initializer_list<T> cList);
+        explicit Vector(Allocator& section,std::initializer_list<T> cList);
         /*!
          * @brief   Destructor to notify the lower layers that the memory used
          *          by the self is not needed anymore and it has to be released
@@ -84,6 +111,39 @@ class Vector: public Container {
          * @return  True if the object is not corrupted. Otherwise, False.
          */
         virtual bool push_back(Vector<T>& toAppend);
+        /*!
+         * @brief   It appends n elements at once: the object is reallocated
+         *          once and the elements are copied in a single pass
+         * @param   first pointer to the first element to append
+         * @param   n number of elements to append
+         * @note    If first points to another object of the same arena,
+         *          reserve() the space before, so it does not move while
+         *          copying. A range of the object itself is handled
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        virtual bool append(const T* first, std::size_t n);
+        /*!
+         * @brief   It inserts the elements in [first, last) before the
+         *          position pos, moving the next elements only once
+         * @param   pos position of the first inserted element. It can not be
+         *          bigger than size()
+         * @param   first pointer to the first element to insert
+         * @param   last pointer after the last element to insert
+         * @note    [first, last) can be a range of the object itself, even
+         *          if the object moves when it grows
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        virtual bool insert(uint32_t pos, const T* first, const T* last);
+        /*!
+         * @brief   It replaces the elements of the object with the ones in
+         *          [first, last)
+         * @param   first pointer to the first element
+         * @param   last pointer after the last element
+         * @note    [first, last) can be a range of the object itself. It is
+         *          moved to the front, without growing the object
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        virtual bool assign(const T* first, const T* last);
         /*!
          * @brief   It assignes more space for the object. The space is based on
          *          the type T, so different bytes might be allocated for the same
@@ -105,11 +165,49 @@ class Vector: public Container {
          * @return  True if the object is not corrupted. Otherwise, False.
          */
         virtual void erase(uint32_t index,bool& erased);
+        /*!
+         * @brief   It removes the elements in [first, last) at once, so the
+         *          next elements are moved only once. The capacity is kept,
+         *          see shrink_to_fit()
+         * @param   first Position of the first element to remove
+         * @param   last Position after the last element to remove
+         */
+        virtual void erase(uint32_t first,uint32_t last);
+        /*!
+         * @brief   It reserves space for at least newCapacity elements, so the
+         *          next appends don't need to reallocate the arena
+         * @param   newCapacity Number of elements to reserve
+         * @note    It never reduces the capacity. See shrink_to_fit()
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        virtual bool reserve(uint32_t newCapacity);
+        /*!
+         * @brief   It releases the reserved space which is not used by any
+         *          element, so the arena can use it for other objects
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        virtual bool shrink_to_fit();
+        /*!
+         * @brief   It sets how the capacity grows when an append does not fit
+         * @param   factor New capacity is the current one multiplied by
+         *          factor. It has to be finite and bigger than 1
+         * @note    If the arena cannot provide the geometric growth, the
+         *          capacity grows only the needed elements
+         * @return  True if the factor is used. Otherwise, False and the
+         *          previous one is kept.
+         */
+        bool setGrowthFactor(float factor);
         /*!
          * @brief   It provides the amount of elements of the object
          * @return  The number of elements of size sizeof(T) in the object
          */
         std::size_t size();
+        /*!
+         * @brief   It provides the amount of elements which fit in the
+         *          reserved memory
+         * @return  The number of elements of size sizeof(T) reserved
+         */
+        std::size_t capacity();
         /*!
          * @brief   It indicates if there was a critical failure and the
          *          allocator was not able to recover
@@ -121,7 +219,7 @@ class Vector: public Container {
          * @param   index Index to return
          * @param   outOfBoundaries Flag to notify that the requested index
          *          is bigger than size()
-         * @return  The value in index of type T
+         * @return  The value in index of type T, T() if it is out of boundaries
          */
         T at(uint32_t index,bool& outOfBoundaries) const;
         /*!
@@ -132,18 +230,65 @@ class Vector: public Container {
          *          way, use at()
          */
         const T& operator[](uint32_t index) const;
+        /*!
+         * @brief   It provides the elements as a contiguous array, so they can
+         *          be used by std algorithms or vectorized code
+         * @note    The pointer is valid until the arena moves the object: any
+         *          change of its size or of the size of a previous object in
+         *          the same arena, a deallocation of a previous object or a
+         *          compaction. Writing the elements does not invalidate it.
+         *          In a CrcAllocation, written elements have to be notified
+         *          with markDirty() before the next updateDirtyMirror().
+         * @return  Pointer to the first element, nullptr if no space was
+         *          reserved
+         */
+        T* data();
+        const T* data() const;
+        /*!
+         * @brief   Iterators to the first element and after the last one.
+         *          Invalidated as data()
+         */
+        T* begin();
+        T* end();
+        const T* begin() const;
+        const T* end() const;
+        /*!
+         * @brief   View of all the elements. Invalidated as data()
+         */
+        Span<T> span();
+        Span<const T> span() const;
     protected:
         Vector();
+        bool growTo(Allocator *section, uint32_t minCapacity);
+        // Bytes that growTo(minCapacity) can add to the object
+        std::size_t growthBytes(uint32_t minCapacity);
+        // Capacity after a geometric growth, saturated to UINT32_MAX
+        uint32_t geometricCapacity();
+        bool shrinkTo(Allocator *section, uint32_t newCapacity);
+        bool eraseRange(Allocator *section, uint32_t first, uint32_t last);
+        bool assignRange(Allocator *section, const T* first, std::size_t n);
+        bool insertRange(Allocator *section, uint32_t pos, const T* first, \
+                std::size_t n);
         bool internalFailure;
         uint32_t elements;
+        uint32_t capacityElements;
+        float growthFactor;
     private:
-        BasicAllocation *arena;
+        Allocator *arena;
 };
 
 template <typename T>
 class CrcVector: public Vector<T> {
     using Vector<T>::internalFailure;
     using Vector<T>::elements;
+    using Vector<T>::capacityElements;
+    using Vector<T>::growthFactor;
+    using Vector<T>::growTo;
+    using Vector<T>::growthBytes;
+    using Vector<T>::shrinkTo;
+    using Vector<T>::eraseRange;
+    using Vector<T>::assignRange;
+    using Vector<T>::insertRange;
     using Vector<T>::aMem;
     public:
         /*!
@@ -197,6 +342,32 @@ class CrcVector: public Vector<T> {
          * @return  True if the object is not corrupted. Otherwise, False.
          */
         bool push_back(Vector<T>& toAppend);
+        /*!
+         * @brief   It appends n elements at once, with a single check and
+         *          update of the mirror
+         * @param   first pointer to the first element to append
+         * @param   n number of elements to append
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool append(const T* first, std::size_t n);
+        /*!
+         * @brief   It inserts the elements in [first, last) before the
+         *          position pos, with a single check and update of the mirror
+         * @param   pos position of the first inserted element
+         * @param   first pointer to the first element to insert
+         * @param   last pointer after the last element to insert
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool insert(uint32_t pos, const T* first, const T* last);
+        /*!
+         * @brief   It replaces the elements of the object with the ones in
+         *          [first, last)
+         * @param   first pointer to the first element
+         * @param   last pointer after the last element
+         * @note    [first, last) can be a range of the object itself
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool assign(const T* first, const T* last);
         /*!
          * @brief   It assignes more space for the object. The space is based on
          *          the type T, so different bytes might be allocated for the same
@@ -218,35 +389,62 @@ class CrcVector: public Vector<T> {
          * @return  True if the object is not corrupted. Otherwise, False.
          */
         void erase(uint32_t index,bool& erased);
+        /*!
+         * @brief   It removes the elements in [first, last) at once, so the
+         *          next elements are moved only once. The capacity is kept,
+         *          see shrink_to_fit()
+         * @param   first Position of the first element to remove
+         * @param   last Position after the last element to remove
+         */
+        void erase(uint32_t first,uint32_t last);
+        /*!
+         * @brief   It reserves space for at least newCapacity elements, so the
+         *          next appends don't need to reallocate the arena
+         * @param   newCapacity Number of elements to reserve
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool reserve(uint32_t newCapacity);
+        /*!
+         * @brief   It releases the reserved space which is not used by any
+         *          element
+         * @return  True if the object is jeopardized. Otherwise, False.
+         */
+        bool shrink_to_fit();
     protected:
         CrcVector();
     private:
+        // Check of the blocks written by a change of the elements from pos
+        // which needs minCapacity elements. Only those elements while the
+        // capacity is enough, see CrcAllocation::checkObject() otherwise
+        bool checkFrom(uint32_t pos, uint32_t minCapacity);
+        // Check of the blocks written by a removal, see checkObject()
+        bool checkRemoval();
         CrcAllocation *arena;
 };
 
 
-// Valid types
-template class  Vector<int16_t>;
-template class  Vector<uint16_t>;
-template class  Vector<unsigned char>;
-template class  Vector<char>;
-template class  Vector<unsigned int>;
-template class  Vector<int>;
-template class  Vector<unsigned long>;
-template class  Vector<long>;
-template class  Vector<float>;
-template class  Vector<double>;
+// Valid types, instantiated in vector.cpp
+extern template class  Vector<int16_t>;
+extern template class  Vector<uint16_t>;
+extern template class  Vector<unsigned char>;
+extern template class  Vector<char>;
+extern template class  Vector<unsigned int>;
+extern template class  Vector<int>;
+extern template class  Vector<unsigned long>;
+extern template class  Vector<long>;
+extern template class  Vector<float>;
+extern template class  Vector<double>;
 
-template class  CrcVector<int16_t>;
-template class  CrcVector<uint16_t>;
-template class  CrcVector<unsigned char>;
-template class  CrcVector<char>;
-template class  CrcVector<unsigned int>;
-template class  CrcVector<int>;
-template class  CrcVector<unsigned long>;
-template class  CrcVector<long>;
-template class  CrcVector<float>;
-template class  CrcVector<double>;
+extern template class  CrcVector<int16_t>;
+extern template class  CrcVector<uint16_t>;
+extern template class  CrcVector<unsigned char>;
+extern template class  CrcVector<char>;
+extern template class  CrcVector<unsigned int>;
+extern template class  CrcVector<int>;
+extern template class  CrcVector<unsigned long>;
+extern template class  CrcVector<long>;
+extern template class  CrcVector<float>;
+extern template class  CrcVector<double>;
 
 }; // end namespace
 
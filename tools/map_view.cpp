@@ -0,0 +1,213 @@
+/*!
+ * @file      map_view.cpp
+ *
+ * @brief     Offline view of the arena maps written by
+ *            BasicAllocation::writeMapBinary(). Every snapshot of the file is
+ *            shown in one line, so the occupancy and the fragmentation can be
+ *            followed over time:
+ *              '#' live data, 'P' pinned data, 'x' dead data, '.' holes
+ *              before the pinned objects, '=' address area and its reserved
+ *              entries, ' ' free
+ *
+ * @note      Usage: map_view.out <file> [--width N] [--csv]
+ *            --csv prints the summary of every snapshot instead:
+ *            snapshot,objects,arena_bytes,data_bytes,table_bytes,live_bytes,
+ *            dead_bytes,gap_bytes,free_bytes,fragmentation
+ *
+ * @date      10 May 2020
+ *
+ * @version   Revision 1.0.0
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include "allocator.hpp"
+
+enum cellKind {
+    CELL_FREE=0,
+    CELL_LIVE=1,
+    CELL_PINNED=2,
+    CELL_DEAD=3,
+    CELL_GAP=4,
+    CELL_TABLE=5,
+    CELL_KINDS=6
+};
+
+const char CELL_SYMBOLS[CELL_KINDS] = {' ', '#', 'P', 'x', '.', '='};
+
+struct Snapshot {
+    cus::MapSummary summary;
+    // Bytes of the address area, the reserved ones included
+    arch_t tableSpace;
+    std::vector<cus::MapEntry> entries;
+};
+
+static bool readSnapshot(std::istream& in, Snapshot& snapshot) {
+    arch_t header[cus::MAP_HEADER_WORDS];
+    if(!in.read((char *)header, sizeof(header))) {
+        return false;
+    }
+    if((uint32_t)header[0] != cus::MAP_MAGIC || \
+            (uint32_t)(header[0] >> 32) != cus::MAP_VERSION) {
+        std::cerr << "Not a map of version " << cus::MAP_VERSION << std::endl;
+        return false;
+    }
+    snapshot.summary = {};
+    snapshot.summary.arenaBytes = header[1];
+    snapshot.summary.dataBytes = header[2];
+    snapshot.summary.tableBytes = header[3];
+    snapshot.summary.objects = header[4];
+    // The data does not grow into the reserved entries, see StaticArena
+    snapshot.tableSpace = (header[3] > header[5]) ? header[3] : header[5];
+    snapshot.summary.freeBytes = header[1] - header[2] - snapshot.tableSpace;
+    snapshot.entries.clear();
+
+    // Same accounting as BasicAllocation::exportMap()
+    arch_t expectedNextAddr = 0;
+    for(arch_t idx=0;idx<snapshot.summary.objects;idx++) {
+        arch_t words[cus::MAP_ENTRY_WORDS];
+        if(!in.read((char *)words, sizeof(words))) {
+            std::cerr << "Truncated map" << std::endl;
+            return false;
+        }
+        cus::MapEntry entry;
+        entry.dataOffset = words[0];
+        entry.size = words[1] & ~cus::MAP_PINNED;
+        entry.pinned = (words[1] & cus::MAP_PINNED) != 0;
+        entry.requester = words[2];
+        entry.dead = (entry.requester == 0);
+        if(entry.dead) {
+            snapshot.summary.deadBytes += entry.size;
+        } else {
+            snapshot.summary.liveBytes += entry.size;
+        }
+        if(entry.dataOffset > expectedNextAddr) {
+            snapshot.summary.gapBytes += entry.dataOffset - expectedNextAddr;
+        }
+        expectedNextAddr = entry.dataOffset + entry.size;
+        snapshot.entries.push_back(entry);
+    }
+    if(snapshot.summary.dataBytes != 0) {
+        snapshot.summary.fragmentation = (double)(snapshot.summary.deadBytes + \
+                snapshot.summary.gapBytes) / (double)snapshot.summary.dataBytes;
+    }
+    return true;
+}
+
+// Bytes of every kind in every cell, the cell shows the kind with most bytes
+class Occupancy {
+    public:
+        Occupancy(arch_t arenaBytes, uint32_t width) : bytes(arenaBytes), \
+            cells(width, std::vector<arch_t>(CELL_KINDS, 0)) {
+            add(CELL_FREE, 0, arenaBytes);
+        }
+        void add(cellKind kind, arch_t from, arch_t to) {
+            if(bytes == 0) {
+                return;
+            }
+            arch_t width = cells.size();
+            for(arch_t cell=from*width/bytes;cell<width && cell*bytes/width<to;cell++) {
+                arch_t cellStart = cell*bytes/width;
+                arch_t cellEnd = (cell+1)*bytes/width;
+                arch_t overlapStart = (from > cellStart) ? from : cellStart;
+                arch_t overlapEnd = (to < cellEnd) ? to : cellEnd;
+                if(overlapEnd > overlapStart) {
+                    // Every byte counts once, the free bytes are the rest
+                    cells[cell][kind] += overlapEnd - overlapStart;
+                    if(kind != CELL_FREE) {
+                        cells[cell][CELL_FREE] -= overlapEnd - overlapStart;
+                    }
+                }
+            }
+        }
+        std::string render() const {
+            std::string bar;
+            for(const std::vector<arch_t>& cell : cells) {
+                uint32_t best = CELL_FREE;
+                for(uint32_t kind=1;kind<CELL_KINDS;kind++) {
+                    if(cell[kind] > cell[best]) {
+                        best = kind;
+                    }
+                }
+                bar += CELL_SYMBOLS[best];
+            }
+            return bar;
+        }
+    private:
+        arch_t bytes;
+        std::vector<std::vector<arch_t>> cells;
+};
+
+static std::string render(const Snapshot& snapshot, uint32_t width) {
+    const cus::MapSummary& summary = snapshot.summary;
+    Occupancy occupancy(summary.arenaBytes, width);
+    arch_t expectedNextAddr = 0;
+    for(const cus::MapEntry& entry : snapshot.entries) {
+        if(entry.dataOffset > expectedNextAddr) {
+            occupancy.add(CELL_GAP, expectedNextAddr, entry.dataOffset);
+        }
+        cellKind kind = entry.dead ? CELL_DEAD : (entry.pinned ? CELL_PINNED : CELL_LIVE);
+        occupancy.add(kind, entry.dataOffset, entry.dataOffset + entry.size);
+        expectedNextAddr = entry.dataOffset + entry.size;
+    }
+    occupancy.add(CELL_TABLE, summary.arenaBytes - snapshot.tableSpace, summary.arenaBytes);
+    return occupancy.render();
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file> [--width N] [--csv]" << std::endl;
+        return 1;
+    }
+    uint32_t width = 64;
+    bool csv = false;
+    for(int arg=2;arg<argc;arg++) {
+        std::string option(argv[arg]);
+        if(option == "--csv") {
+            csv = true;
+        } else if(option == "--width" && arg+1 < argc) {
+            width = (uint32_t)std::strtoul(argv[++arg], nullptr, 10);
+        }
+    }
+    if(width == 0) {
+        width = 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if(!in) {
+        std::cerr << "Can not open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    if(csv) {
+        std::cout << "snapshot,objects,arena_bytes,data_bytes,table_bytes,live_bytes," \
+                     "dead_bytes,gap_bytes,free_bytes,fragmentation" << std::endl;
+    } else {
+        std::cout << "snapshot objects  frag% occupancy" << std::endl;
+    }
+    Snapshot snapshot;
+    uint32_t count = 0;
+    while(in.peek() != EOF) {
+        if(readSnapshot(in, snapshot) == false) {
+            return 1;
+        }
+        const cus::MapSummary& summary = snapshot.summary;
+        if(csv) {
+            std::cout << count << "," << summary.objects << "," << summary.arenaBytes \
+                      << "," << summary.dataBytes << "," << summary.tableBytes \
+                      << "," << summary.liveBytes << "," << summary.deadBytes \
+                      << "," << summary.gapBytes << "," << summary.freeBytes \
+                      << "," << summary.fragmentation << std::endl;
+        } else {
+            char line[64];
+            std::snprintf(line, sizeof(line), "%8u %7llu %6.1f ", count, \
+                    (unsigned long long)summary.objects, summary.fragmentation*100);
+            std::cout << line << "|" << render(snapshot, width) << "|" << std::endl;
+        }
+        count++;
+    }
+    return 0;
+}
@@ -4,6 +4,13 @@
 
 #include "catch2/catch.hpp"
 #include <allocator.hpp>
+#include <static_arena.hpp>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sstream>
 
 const uint32_t SIZE_ARENA=500;
 const uint32_t END_ARENA=500;
@@ -47,17 +54,17 @@ TEST_CASE( "Multiple allocations", \
 }
 
 TEST_CASE( "Max. allocated size", \
-        "sizeArena/2 >= (allocations*size) + \
-        (allocations * 3 * sizeof(arch_t)) + (2 * sizeof(arch_t))" ) {
+        "sizeArena >= (allocations*size) + \
+        (allocations * 3 * sizeof(arch_t))" ) {
     char arena[SIZE_ARENA];
     cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
                                    reinterpret_cast<void *>(&arena[END_ARENA]));
 
     uint32_t elements=0;
     const std::size_t sizeB_mockRequester=4;
-    uint32_t maxAllocations=(((SIZE_ARENA)-(sizeof(arch_t)))/ \
-            (sizeB_mockRequester+(3*sizeof(arch_t))));
-    while(elements <= maxAllocations) {
+    uint32_t maxAllocations=SIZE_ARENA/ \
+            (sizeB_mockRequester+(3*sizeof(arch_t)));
+    while(elements < maxAllocations) {
         void * mockRequester;
 
         bool valid=mockArena.allocate((arch_t)&mockRequester,mockRequester,sizeB_mockRequester);
@@ -557,7 +564,7 @@ TEST_CASE( "Multiple CrcAllocations", \
 
 TEST_CASE( "Max. CrcAllocates size", \
         "sizeArena/2 >= (allocations*size) + \
-        (allocations * 3 * sizeof(arch_t)) + (sizeof(arch_t))" ) {
+        (allocations * 3 * sizeof(arch_t)) + sizeof(arch_t)" ) {
     char arena[SIZE_ARENA];
     cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
                                    reinterpret_cast<void *>(&arena[END_ARENA]));
@@ -570,7 +577,7 @@ TEST_CASE( "Max. CrcAllocates size", \
         void * mockRequester;
         bool valid=mockArena.allocate((arch_t)&mockRequester,mockRequester,sizeB_mockRequester);
 
-        if(elements<=maxAllocations) {
+        if(elements<maxAllocations) {
             REQUIRE( valid == true );
         } else {
             REQUIRE( valid == false );
@@ -948,3 +955,1672 @@ TEST_CASE( "Restore data", \
         REQUIRE( arena[(SIZE_ARENA/2)+(20)] == 0x5A );
     }
 }
+
+
+
+// Indexed lookups
+//
+
+
+TEST_CASE( "Indexed allocation", \
+        "The index is placed at the top of the section and data starts at the bottom" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 4);
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    bool valid_a=mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,4);
+    bool valid_b=mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,16);
+
+    REQUIRE( valid_a == true );
+    REQUIRE( valid_b == true );
+    REQUIRE( reinterpret_cast<arch_t>(mockRequester_a) == \
+             (reinterpret_cast<arch_t>(&arena[0]) ) );
+    REQUIRE( reinterpret_cast<arch_t>(mockRequester_b) == \
+             (reinterpret_cast<arch_t>(mockRequester_a) + 4) );
+    REQUIRE( mockArena.elements() == 2 );
+}
+
+TEST_CASE( "Indexed clashes passing objects", \
+        "the same object cannot allocate two times when indexed" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 4);
+
+    void * mockRequester=nullptr;
+    bool valid_1 = mockArena.allocate((arch_t)&mockRequester,mockRequester,4);
+    void * tempMockRequester = mockRequester;
+    bool valid_2 = mockArena.allocate((arch_t)&mockRequester,mockRequester,4);
+
+    REQUIRE( valid_1 == true );
+    REQUIRE( valid_2 == false );
+    REQUIRE( tempMockRequester == mockRequester );
+    REQUIRE( mockArena.elements() == 1 );
+}
+
+TEST_CASE( "Indexed capacity", \
+        "No more objects than indexed ones can be allocated" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    const uint32_t indexed=5;
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), indexed);
+
+    void * mockRequester[indexed+1];
+    for(uint32_t idx=0;idx<indexed;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],1) == true );
+    }
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester[indexed], \
+                mockRequester[indexed],1) == false );
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester[indexed], \
+                mockRequester[indexed],1) == true );
+}
+
+TEST_CASE( "Indexed deallocation", \
+        "Deallocations in any order keep the index and the requesters in sync" ) {
+    const uint32_t objects=64;
+    const uint32_t sizeIndexedArena=objects*(4*sizeof(arch_t)) + \
+                                    objects*(3*sizeof(arch_t)+sizeof(uint32_t));
+    arch_t arena[sizeIndexedArena/sizeof(arch_t)];
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                reinterpret_cast<void *>((char *)&arena[0]+sizeIndexedArena), objects);
+
+    void * mockRequester[objects];
+    for(uint32_t idx=0;idx<objects;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx], \
+                    sizeof(uint32_t)) == true );
+        *(uint32_t *)mockRequester[idx] = idx;
+    }
+
+    // Remove every third object, then grow and shrink the survivors
+    for(uint32_t idx=0;idx<objects;idx+=3) {
+        REQUIRE( mockArena.deallocate((arch_t)&mockRequester[idx]) == true );
+        REQUIRE( mockArena.deallocate((arch_t)&mockRequester[idx]) == false );
+    }
+    for(uint32_t idx=1;idx<objects;idx+=3) {
+        REQUIRE( mockArena.reallocate(mockRequester[idx],sizeof(uint32_t), \
+                    2*sizeof(uint32_t)) == true );
+        REQUIRE( mockArena.removeElement((arch_t)&mockRequester[idx], \
+                    (uint32_t *)mockRequester[idx]+1,sizeof(uint32_t)) == true );
+    }
+
+    for(uint32_t idx=0;idx<objects;idx++) {
+        if((idx%3)!=0) {
+            REQUIRE( *(uint32_t *)mockRequester[idx] == idx );
+        }
+    }
+    REQUIRE( mockArena.elements() == objects-((objects+2)/3) );
+}
+
+
+
+// CRC
+//
+
+
+static uint32_t bitwiseCrc(uint32_t poly, const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    while(len--) {
+        crc ^= *data++;
+        for(uint32_t k=0;k<8;k++) {
+            crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+TEST_CASE( "CRC check values", "Both polynomials provide the standard check values" ) {
+    cus::MathArch math;
+    const char check[] = "123456789";
+
+    REQUIRE( math.crc32(check, check+9) == 0xE3069283 );
+    math.setCrcPolynomial(cus::MathArch::CRC32_IEEE);
+    REQUIRE( math.crc32(check, check+9) == 0xCBF43926 );
+    REQUIRE( math.crc32(check, check) == 0 );
+}
+
+TEST_CASE( "CRC of any alignment", "Slices and hardware match the bitwise CRC" ) {
+    cus::MathArch math;
+    uint8_t data[300];
+    for(uint32_t idx=0;idx<sizeof(data);idx++) {
+        data[idx] = (uint8_t)(idx*151 + 3);
+    }
+
+    for(uint32_t offset=0;offset<9;offset++) {
+        for(uint32_t len=0;len<(sizeof(data)-offset);len+=17) {
+            math.setCrcPolynomial(cus::MathArch::CRC32C);
+            REQUIRE( math.crc32(&data[offset], &data[offset+len]) == \
+                    bitwiseCrc(0x82f63b78, &data[offset], len) );
+            math.setCrcPolynomial(cus::MathArch::CRC32_IEEE);
+            REQUIRE( math.crc32(&data[offset], &data[offset+len]) == \
+                    bitwiseCrc(0xedb88320, &data[offset], len) );
+        }
+    }
+}
+
+TEST_CASE( "Check with IEEE polynomial", "The polynomial can be changed in a CrcAllocation" ) {
+    char arena[SIZE_ARENA];
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setCrcPolynomial(cus::MathArch::CRC32_IEEE);
+    mockArena.updateMirror();
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,16) == true );
+    std::memset(mockRequester, 0x33, 16);
+    mockArena.updateMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+
+    ((char *)mockRequester)[3] = 0x44;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[3] == 0x33 );
+}
+
+
+
+// Dirty mirroring
+//
+
+
+TEST_CASE( "Dirty mirror", \
+        "Mirroring only the written areas provides the same CRCs as a full update" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,10) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,20) == true );
+    std::memset(mockRequester_a, 0x11, 10);
+    std::memset(mockRequester_b, 0x22, 20);
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c,5) == true );
+    std::memset(mockRequester_c, 0x33, 5);
+    REQUIRE( mockArena.reallocate(mockRequester_a,10,14) == true );
+    std::memset((char *)mockRequester_a+10, 0x44, 4);
+    REQUIRE( mockArena.removeElement((arch_t)&mockRequester_b, \
+                (char *)mockRequester_b+2, 6) == true );
+    ((char *)mockRequester_b)[0] = 0x55;
+    mockArena.markDirty(mockRequester_b, 1);
+    mockArena.updateDirtyMirror();
+
+    arch_t crcOrig;
+    arch_t crcMirror;
+    std::memcpy(&crcOrig, &arena[0], sizeof(arch_t));
+    std::memcpy(&crcMirror, &arena[SIZE_ARENA/2], sizeof(arch_t));
+
+    mockArena.updateMirror();
+    REQUIRE( std::memcmp(&crcOrig, &arena[0], sizeof(arch_t)) == 0 );
+    REQUIRE( std::memcmp(&crcMirror, &arena[SIZE_ARENA/2], sizeof(arch_t)) == 0 );
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+TEST_CASE( "Unreported writes", \
+        "Writes which are not notified are restored from the mirror" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    std::memset(mockRequester, 0x11, 8);
+    mockArena.updateDirtyMirror();
+
+    ((char *)mockRequester)[1] = 0x22;
+    ((char *)mockRequester)[5] = 0x33;
+    mockArena.markDirty((char *)mockRequester+5, 1);
+    mockArena.updateDirtyMirror();
+
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[1] == 0x11 );
+    REQUIRE( ((char *)mockRequester)[5] == 0x33 );
+}
+
+TEST_CASE( "Corruption beside pending writes", \
+        "Only the notified bytes of a dirty block are taken from the original" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    std::memset(mockRequester, 0x11, 8);
+    mockArena.updateDirtyMirror();
+
+    // The check runs before the write of byte 5 is mirrored
+    ((char *)mockRequester)[1] = 0x22;
+    ((char *)mockRequester)[5] = 0x33;
+    mockArena.markDirty((char *)mockRequester+5, 1);
+
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[1] == 0x11 );
+    REQUIRE( ((char *)mockRequester)[5] == 0x33 );
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[5] == 0x33 );
+}
+
+TEST_CASE( "Corrupted mirror of pending writes", \
+        "The original replaces the mirror of the bytes written since the last update" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    std::memset(mockRequester, 0x11, 8);
+    mockArena.updateDirtyMirror();
+
+    // The mirror of byte 5 is corrupted before its write is mirrored. Each
+    // half starts with its CRC
+    ((char *)mockRequester)[5] = 0x33;
+    mockArena.markDirty((char *)mockRequester+5, 1);
+    arch_t offset = (char *)mockRequester - &arena[sizeof(arch_t)];
+    arena[SIZE_ARENA/2 + sizeof(arch_t) + offset + 5] ^= 0x0F;
+
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[1] == 0x11 );
+    REQUIRE( ((char *)mockRequester)[5] == 0x33 );
+    REQUIRE( arena[SIZE_ARENA/2 + sizeof(arch_t) + offset + 5] == (char)~0x33 );
+
+    // The mirror is valid again, so it restores the original
+    ((char *)mockRequester)[1] = 0x22;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[1] == 0x11 );
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[5] == 0x33 );
+}
+
+//
+// Block CRCs
+//
+
+
+TEST_CASE( "Block layout", \
+        "Every half starts with one CRC per block" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 64);
+
+    // 250 bytes per half need 4 blocks of 64 bytes
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    REQUIRE( mockRequester == &arena[4*sizeof(arch_t)] );
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+TEST_CASE( "Block dirty mirror", \
+        "Mirroring only the written areas provides the same block CRCs as a full update" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 64);
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,60) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,40) == true );
+    std::memset(mockRequester_a, 0x11, 60);
+    std::memset(mockRequester_b, 0x22, 40);
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.reallocate(mockRequester_a,60,80) == true );
+    std::memset((char *)mockRequester_a+60, 0x33, 20);
+    mockArena.updateDirtyMirror();
+
+    char crcs[2][4*sizeof(arch_t)];
+    std::memcpy(crcs[0], &arena[0], sizeof(crcs[0]));
+    std::memcpy(crcs[1], &arena[SIZE_ARENA/2], sizeof(crcs[1]));
+
+    mockArena.updateMirror();
+    REQUIRE( std::memcmp(crcs[0], &arena[0], sizeof(crcs[0])) == 0 );
+    REQUIRE( std::memcmp(crcs[1], &arena[SIZE_ARENA/2], sizeof(crcs[1])) == 0 );
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+TEST_CASE( "Block restore", \
+        "Corruptions in different copies of different blocks are restored" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 64);
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,190) == true );
+    std::memset(mockRequester, 0x11, 190);
+    mockArena.updateDirtyMirror();
+
+    // Original corrupted in the first block, mirror in the third one
+    ((char *)mockRequester)[3] = 0x22;
+    arena[SIZE_ARENA/2 + 4*sizeof(arch_t) + 130] = 0x22;
+
+    // A single CRC can not tell which copy is valid
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[3] == 0x11 );
+    REQUIRE( arena[SIZE_ARENA/2 + 4*sizeof(arch_t) + 130] == (char)~0x11 );
+}
+
+TEST_CASE( "Block range check", \
+        "Only the blocks of the given area are checked" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 64);
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,190) == true );
+    std::memset(mockRequester, 0x11, 190);
+    mockArena.updateDirtyMirror();
+
+    ((char *)mockRequester)[3] = 0x22;
+    ((char *)mockRequester)[130] = 0x22;
+
+    REQUIRE( mockArena.checkConsistency((char *)mockRequester+128, 8) == true );
+    REQUIRE( ((char *)mockRequester)[3] == 0x22 );
+    REQUIRE( ((char *)mockRequester)[130] == 0x11 );
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[3] == 0x11 );
+}
+
+TEST_CASE( "Small block sizes", \
+        "Blocks below the minimum size are clamped, so the CRCs always fit" ) {
+    const uint32_t SIZE_SECTION=1024;
+    char arena[SIZE_SECTION] __attribute__ ((aligned (8)));
+    // 512 bytes per half fit 8 CRCs and 7 blocks of 64 bytes
+    uint32_t blockSizes[3] = {4, 8, 60};
+    for(uint32_t idx=0;idx<3;idx++) {
+        cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                       reinterpret_cast<void *>(&arena[SIZE_SECTION]), \
+                                       blockSizes[idx]);
+        void * mockRequester;
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,200) == true );
+        REQUIRE( mockRequester == &arena[8*sizeof(arch_t)] );
+        std::memset(mockRequester, 0x11, 200);
+        mockArena.updateDirtyMirror();
+        REQUIRE( mockArena.checkConsistency() == true );
+    }
+
+    // Other sizes are rounded up to a multiple of the word, 104 bytes here
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[SIZE_SECTION]), 100);
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    REQUIRE( mockRequester == &arena[5*sizeof(arch_t)] );
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+//
+// Batches
+//
+
+
+TEST_CASE( "Batch", \
+        "Checks and updates are deferred until the last batch is closed" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    std::memset(mockRequester, 0x11, 8);
+    mockArena.updateDirtyMirror();
+
+    REQUIRE( mockArena.beginBatch() == true );
+    REQUIRE( mockArena.beginBatch() == true );
+    ((char *)mockRequester)[1] = 0x22;
+    mockArena.markDirty((char *)mockRequester+1, 1);
+    mockArena.updateDirtyMirror();
+    // The written byte is not restored while the batch is open
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[1] == 0x22 );
+    mockArena.endBatch();
+    REQUIRE( ((char *)mockRequester)[1] == 0x22 );
+    mockArena.endBatch();
+
+    ((char *)mockRequester)[3] = 0x33;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester)[1] == 0x22 );
+    REQUIRE( ((char *)mockRequester)[3] == 0x11 );
+}
+
+TEST_CASE( "Corrupted batch", \
+        "A batch opened in a corrupted arena reports it until it is closed" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester,mockRequester,8) == true );
+    mockArena.updateDirtyMirror();
+
+    // Both copies corrupted
+    ((char *)mockRequester)[0] ^= 0x01;
+    arena[SIZE_ARENA/2 + sizeof(arch_t)] ^= 0x01;
+
+    {
+        cus::CrcBatch batch(mockArena);
+        REQUIRE( batch.isConsistent() == false );
+        REQUIRE( mockArena.checkConsistency() == false );
+    }
+    REQUIRE( mockArena.checkConsistency() == false );
+}
+
+//
+// Threads
+//
+
+
+TEST_CASE( "Size of an element", "The reserved bytes of an object are provided" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c = nullptr;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,10) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,20) == true );
+    REQUIRE( mockArena.sizeElement(mockRequester_a) == 10 );
+    REQUIRE( mockArena.sizeElement(mockRequester_b) == 20 );
+    REQUIRE( mockArena.sizeElement(mockRequester_c) == 0 );
+}
+
+TEST_CASE( "Shared arena", "Changes from several threads are serialized" ) {
+    const uint32_t THREADS=4;
+    const uint32_t OBJECTS=8;
+    const uint32_t SIZE_SHARED=8192;
+    static char arena[SIZE_SHARED] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[SIZE_SHARED]));
+    mockArena.setThreadSafe(true);
+
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> wrongCount(0);
+    std::thread reader([&]() {
+        while(done==false) {
+            if(mockArena.elements() > THREADS*OBJECTS) {
+                wrongCount++;
+            }
+            // The map is read without stopping the writers
+            cus::MapSummary summary = mockArena.exportMap();
+            if(summary.objects > THREADS*OBJECTS || \
+                    summary.liveBytes != summary.objects*16) {
+                wrongCount++;
+            }
+        }
+    });
+
+    std::vector<std::thread> writers;
+    std::atomic<uint32_t> failures(0);
+    for(uint32_t th=0;th<THREADS;th++) {
+        writers.emplace_back([&]() {
+            void * mockRequester[OBJECTS];
+            for(uint32_t it=0;it<500;it++) {
+                for(uint32_t obj=0;obj<OBJECTS;obj++) {
+                    if(mockArena.allocate((arch_t)&mockRequester[obj], \
+                                mockRequester[obj],16) == false) {
+                        failures++;
+                    }
+                }
+                for(uint32_t obj=0;obj<OBJECTS;obj++) {
+                    if(mockArena.deallocate((arch_t)&mockRequester[obj]) == false) {
+                        failures++;
+                    }
+                }
+            }
+        });
+    }
+    for(auto& writer : writers) {
+        writer.join();
+    }
+    done=true;
+    reader.join();
+
+    REQUIRE( failures == 0 );
+    REQUIRE( wrongCount == 0 );
+    REQUIRE( mockArena.elements() == 0 );
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+TEST_CASE( "Thread local arenas", "Every thread gets its own sub arena" ) {
+    // The sub arena objects live in the section
+    const uint32_t SIZE_SHARED=4096 + 2*sizeof(cus::BasicAllocation);
+    static char arena[SIZE_SHARED] __attribute__ ((aligned (8)));
+    cus::ThreadLocalAllocation mockArenas(reinterpret_cast<void *>(&arena[0]), \
+                                          reinterpret_cast<void *>(&arena[SIZE_SHARED]), 2);
+
+    cus::BasicAllocation *mainArena = mockArenas.local();
+    REQUIRE( mockArenas.total() == 2 );
+    REQUIRE( mainArena != nullptr );
+    REQUIRE( mockArenas.local() == mainArena );
+    REQUIRE( mockArenas.available() == 1 );
+
+    cus::BasicAllocation *threadArena = nullptr;
+    std::thread first([&]() {
+        threadArena = mockArenas.local();
+        void * mockRequester;
+        if(threadArena != nullptr) {
+            threadArena->allocate((arch_t)&mockRequester,mockRequester,16);
+            threadArena->deallocate((arch_t)&mockRequester);
+        }
+    });
+    first.join();
+    REQUIRE( threadArena != nullptr );
+    REQUIRE( threadArena != mainArena );
+    // The empty sub arena was given back when the thread finished
+    REQUIRE( mockArenas.available() == 1 );
+
+    // A sub arena with objects is reused once they are deallocated
+    void * mockRequester;
+    std::thread second([&]() {
+        mockArenas.local()->allocate((arch_t)&mockRequester,mockRequester,16);
+    });
+    second.join();
+    REQUIRE( mockArenas.available() == 0 );
+    REQUIRE( threadArena->deallocate((arch_t)&mockRequester) == true );
+    REQUIRE( mockArenas.available() == 1 );
+
+    mockArenas.release();
+    REQUIRE( mockArenas.available() == 2 );
+}
+
+TEST_CASE( "Thread local arenas too small", "The section must hold the sub arena objects" ) {
+    const uint32_t SIZE_SHARED=2*cus::ThreadLocalAllocation::SUB_ARENA_OVERHEAD;
+    static char arena[SIZE_SHARED] __attribute__ ((aligned (8)));
+    cus::ThreadLocalAllocation mockArenas(reinterpret_cast<void *>(&arena[0]), \
+                                          reinterpret_cast<void *>(&arena[SIZE_SHARED]), 2);
+    // The slots of the sub arenas take the rest of the room
+    REQUIRE( mockArenas.total() == 0 );
+    REQUIRE( mockArenas.available() == 0 );
+    REQUIRE( mockArenas.local() == nullptr );
+
+    cus::ThreadLocalAllocation oneArena(reinterpret_cast<void *>(&arena[0]), \
+                                        reinterpret_cast<void *>(&arena[SIZE_SHARED]), 1);
+    REQUIRE( oneArena.total() == 1 );
+    REQUIRE( oneArena.local() != nullptr );
+    oneArena.release();
+
+    // An unaligned section loses the bytes up to the next word
+    static char other[SIZE_SHARED] __attribute__ ((aligned (8)));
+    cus::ThreadLocalAllocation unaligned(reinterpret_cast<void *>(&other[1]), \
+                                         reinterpret_cast<void *>(&other[SIZE_SHARED]), 1);
+    REQUIRE( unaligned.total() == 1 );
+    cus::BasicAllocation *sub = unaligned.local();
+    REQUIRE( sub != nullptr );
+    REQUIRE( ((arch_t)sub % sizeof(arch_t)) == 0 );
+    unaligned.release();
+}
+
+TEST_CASE( "Thread local arenas in sequence", "A destroyed instance leaves no sub arena behind" ) {
+    const uint32_t SIZE_SHARED=4096 + 2*sizeof(cus::BasicAllocation);
+    static char arena[SIZE_SHARED] __attribute__ ((aligned (8)));
+    std::atomic<uint32_t> step(0);
+    cus::ThreadLocalAllocation *firstInstance = nullptr;
+    cus::BasicAllocation *waitingArena = nullptr;
+
+    // A thread which reserved a sub arena of the first instance outlives it
+    std::thread waiting([&]() {
+        while(step.load() != 1) {
+            std::this_thread::yield();
+        }
+        waitingArena = firstInstance->local();
+        step.store(2);
+        while(step.load() != 3) {
+            std::this_thread::yield();
+        }
+    });
+
+    {
+        cus::ThreadLocalAllocation mockArenas(reinterpret_cast<void *>(&arena[0]), \
+                                              reinterpret_cast<void *>(&arena[SIZE_SHARED]), 2);
+        REQUIRE( mockArenas.local() != nullptr );
+        firstInstance = &mockArenas;
+        step.store(1);
+        while(step.load() != 2) {
+            std::this_thread::yield();
+        }
+        REQUIRE( waitingArena != nullptr );
+        REQUIRE( mockArenas.available() == 0 );
+        // Neither this thread nor the waiting one releases them
+    }
+    {
+        cus::ThreadLocalAllocation mockArenas(reinterpret_cast<void *>(&arena[0]), \
+                                              reinterpret_cast<void *>(&arena[SIZE_SHARED]), 2);
+        REQUIRE( mockArenas.available() == 2 );
+        // The entry of the destroyed instance does not give a sub arena
+        // which is not reserved
+        cus::BasicAllocation *mainArena = mockArenas.local();
+        REQUIRE( mainArena != nullptr );
+        REQUIRE( mockArenas.available() == 1 );
+        REQUIRE( mockArenas.local() == mainArena );
+
+        // The waiting thread finishes without touching the first instance
+        step.store(3);
+        waiting.join();
+        REQUIRE( mockArenas.available() == 1 );
+
+        cus::BasicAllocation *otherArena = nullptr;
+        std::thread other([&]() {
+            otherArena = mockArenas.local();
+        });
+        other.join();
+        REQUIRE( otherArena != nullptr );
+        REQUIRE( otherArena != mainArena );
+        REQUIRE( mockArenas.available() == 1 );
+        mockArenas.release();
+        REQUIRE( mockArenas.available() == 2 );
+    }
+}
+
+//
+// Pools
+//
+
+
+TEST_CASE( "Pool allocation", "Objects are placed in blocks of their size class" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::PoolAllocation mockPool(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_a,mockRequester_a,5) == true );
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_b,mockRequester_b,9) == true );
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_c,mockRequester_c,16) == true );
+    REQUIRE( mockPool.elements() == 3 );
+    REQUIRE( mockPool.sizeElement(mockRequester_a) == 8 );
+    REQUIRE( mockPool.sizeElement(mockRequester_b) == 16 );
+    REQUIRE( mockPool.sizeElement(mockRequester_c) == 16 );
+    // Header of two words before every block
+    REQUIRE( mockRequester_a == &arena[2*sizeof(arch_t)] );
+    REQUIRE( mockRequester_b == &arena[(2+1+2)*sizeof(arch_t)] );
+
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_a,mockRequester_a, \
+                cus::PoolAllocation::maxSize()+1) == false );
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_a,mockRequester_a,SIZE_ARENA) == false );
+
+    // Blocks are aligned to the word
+    void * mockRequester_d;
+    REQUIRE( mockPool.allocateAligned((arch_t)&mockRequester_d,mockRequester_d,8, \
+                2*sizeof(arch_t)) == false );
+    REQUIRE( mockPool.allocateAligned((arch_t)&mockRequester_d,mockRequester_d,8, \
+                sizeof(arch_t)) == true );
+    REQUIRE( ((arch_t)mockRequester_d % sizeof(arch_t)) == 0 );
+}
+
+TEST_CASE( "Pool deallocation", "Released blocks are reused and objects never move" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::PoolAllocation mockPool(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_a,mockRequester_a,16) == true );
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_b,mockRequester_b,16) == true );
+    void * previousB = mockRequester_b;
+    void * previousA = mockRequester_a;
+
+    REQUIRE( mockPool.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockPool.deallocate((arch_t)&mockRequester_a) == false );
+    REQUIRE( mockRequester_b == previousB );
+    REQUIRE( mockPool.elements() == 1 );
+
+    REQUIRE( mockPool.allocate((arch_t)&mockRequester_c,mockRequester_c,12) == true );
+    REQUIRE( mockRequester_c == previousA );
+    REQUIRE( mockPool.deallocate((arch_t)&mockRequester_c) == true );
+    REQUIRE( mockPool.deallocate((arch_t)&mockRequester_b) == true );
+    REQUIRE( mockPool.elements() == 0 );
+}
+
+TEST_CASE( "Pool and arena", "A pool and a compacting arena share a section" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::PoolAllocation mockPool(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_ARENA/2]));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[SIZE_ARENA/2]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * fixedRequester;
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockPool.allocate((arch_t)&fixedRequester,fixedRequester,32) == true );
+    std::memset(fixedRequester, 0x11, 32);
+    void * fixedPosition = fixedRequester;
+
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,10) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,10) == true );
+    REQUIRE( mockArena.reallocate(mockRequester_a,10,40) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+
+    REQUIRE( fixedRequester == fixedPosition );
+    REQUIRE( ((char *)fixedRequester)[31] == 0x11 );
+}
+
+//
+// Deferred compaction
+//
+
+
+TEST_CASE( "Deferred free", "Deallocated objects are not moved until compact()" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,10) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,20) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c,30) == true );
+    std::memset(mockRequester_b, 0x22, 20);
+    std::memset(mockRequester_c, 0x33, 30);
+    void * previousC = mockRequester_c;
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == false );
+    // The dead entry is not found through its cleared requester
+    REQUIRE( mockArena.deallocate(0) == false );
+    REQUIRE( mockArena.elements() == 2 );
+    REQUIRE( mockArena.releasedBytes() == 10 );
+    REQUIRE( mockRequester_c == previousC );
+
+    // Later objects still move when another one grows
+    REQUIRE( mockArena.reallocate(mockRequester_b,20,24) == true );
+    REQUIRE( mockRequester_c == (char *)previousC + 4 );
+    REQUIRE( mockArena.sizeElement(mockRequester_c) == 30 );
+
+    mockArena.compact();
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockArena.elements() == 2 );
+    REQUIRE( mockRequester_b == &arena[0] );
+    REQUIRE( mockRequester_c == &arena[24] );
+    REQUIRE( ((char *)mockRequester_b)[19] == 0x22 );
+    REQUIRE( ((char *)mockRequester_c)[29] == 0x33 );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_b) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_c) == true );
+}
+
+TEST_CASE( "Compaction threshold", \
+        "Deallocations compact the arena when the threshold is reached" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]), 8);
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(50);
+
+    void * mockRequester[4];
+    for(uint32_t idx=0;idx<4;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],10) == true );
+    }
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    REQUIRE( mockArena.releasedBytes() == 10 );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[2]) == true );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockRequester[1] == &arena[0] );
+    REQUIRE( mockRequester[3] == &arena[10] );
+
+    // The index follows the compacted entries
+    REQUIRE( mockArena.reallocate(mockRequester[1],10,12) == true );
+    REQUIRE( mockRequester[3] == &arena[12] );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[3]) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[1]) == true );
+    REQUIRE( mockArena.elements() == 0 );
+}
+
+TEST_CASE( "Compaction on allocation", \
+        "An allocation which does not fit recovers the deallocated space" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,300) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,300) == true );
+    REQUIRE( mockRequester_b == &arena[0] );
+    REQUIRE( mockArena.elements() == 1 );
+}
+
+TEST_CASE( "Compaction steps", \
+        "Objects are moved in bounded steps and the arena is usable between them" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+
+    void * mockRequester[6];
+    for(uint32_t idx=0;idx<6;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],16) == true );
+        std::memset(mockRequester[idx], 0x10+idx, 16);
+    }
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[2]) == true );
+
+    // One object per step
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockRequester[1] == (void *)(arena + 8) );
+    REQUIRE( mockArena.elements() == 4 );
+
+    // The arena can be used between steps
+    void * mockRequester_n;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_n,mockRequester_n,8) == true );
+    std::memset(mockRequester_n, 0x20, 8);
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[4]) == true );
+    REQUIRE( mockArena.sizeElement(mockRequester[3]) == 16 );
+
+    while(mockArena.compactStep(40) == false) {
+    }
+    REQUIRE( mockArena.elements() == 4 );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockRequester[1] == (void *)(arena + 8) );
+    REQUIRE( mockRequester[3] == (void *)(arena + 8 + 16) );
+    REQUIRE( mockRequester[5] == (void *)(arena + 8 + 32) );
+    REQUIRE( mockRequester_n == (void *)(arena + 8 + 48) );
+    REQUIRE( ((char *)mockRequester[3])[15] == 0x13 );
+    REQUIRE( ((char *)mockRequester[5])[0] == 0x15 );
+    REQUIRE( ((char *)mockRequester_n)[7] == 0x20 );
+
+    // The mirror follows the moved objects
+    mockArena.updateDirtyMirror();
+    ((char *)mockRequester[5])[3] = 0x7F;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( ((char *)mockRequester[5])[3] == 0x15 );
+
+    void * mockRequester_m;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_m,mockRequester_m,8) == true );
+    REQUIRE( mockRequester_m == (void *)(arena + 8 + 56) );
+}
+
+TEST_CASE( "Compaction step without objects", \
+        "The slack of shrunk objects does not create entries" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,32) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,32) == true );
+    REQUIRE( mockArena.reallocate(mockRequester_a,32,16) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_b) == true );
+    void * const releasedB = mockRequester_b;
+
+    REQUIRE( mockArena.compactStep(1000) == true );
+    REQUIRE( mockArena.elements() == 0 );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockRequester_b == releasedB );
+
+    void * mockRequester_c;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c,8) == true );
+    REQUIRE( mockRequester_c == (void *)&arena[0] );
+    REQUIRE( mockArena.elements() == 1 );
+}
+
+TEST_CASE( "Compaction steps and changes", \
+        "Changes between steps do not move the data of the skipped entries" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(200);
+
+    void * mockRequester_x;
+    void * mockRequester_da;
+    void * mockRequester_db;
+    void * mockRequester_c;
+    void * mockRequester_e;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_x,mockRequester_x,8) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_da,mockRequester_da,16) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_db,mockRequester_db,16) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c,64) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_e,mockRequester_e,8) == true );
+    std::memset(mockRequester_x, 0x11, 8);
+    std::memset(mockRequester_da, 0x22, 16);
+    std::memset(mockRequester_db, 0x33, 16);
+    for(uint32_t idx=0;idx<64;idx++) {
+        ((char *)mockRequester_c)[idx] = idx;
+    }
+    std::memset(mockRequester_e, 0x55, 8);
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_da) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_db) == true );
+
+    // c is moved over the deallocated objects, e is not processed yet
+    for(uint32_t step=0;step<8 && mockRequester_c != (void *)(arena + 8);step++) {
+        REQUIRE( mockArena.compactStep(1) == false );
+    }
+    REQUIRE( mockRequester_c == (void *)(arena + 8) );
+
+    REQUIRE( mockArena.reallocate(mockRequester_x,8,40) == true );
+    REQUIRE( mockRequester_c == (void *)(arena + 40) );
+    for(uint32_t idx=0;idx<64;idx++) {
+        REQUIRE( ((char *)mockRequester_c)[idx] == (char)idx );
+    }
+    REQUIRE( ((char *)mockRequester_e)[7] == 0x55 );
+
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester_c,0,16) == true );
+    for(uint32_t idx=0;idx<48;idx++) {
+        REQUIRE( ((char *)mockRequester_c)[idx] == (char)(idx+16) );
+    }
+
+    while(mockArena.compactStep(1) == false) {
+    }
+    REQUIRE( mockArena.elements() == 3 );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( ((char *)mockRequester_x)[7] == 0x11 );
+    REQUIRE( mockRequester_c == (void *)(arena + 40) );
+    REQUIRE( ((char *)mockRequester_c)[47] == 63 );
+    REQUIRE( mockRequester_e == (void *)(arena + 88) );
+    REQUIRE( ((char *)mockRequester_e)[0] == 0x55 );
+}
+
+TEST_CASE( "Reallocation in place", \
+        "Growing into free space does not move the next objects" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+
+    void * mockRequester[4];
+    for(uint32_t idx=0;idx<4;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],16) == true );
+        std::memset(mockRequester[idx], 0x10+idx, 16);
+    }
+    mockArena.updateDirtyMirror();
+
+    // The last object does not move any other
+    REQUIRE( mockArena.reallocate(mockRequester[3],16,20) == true );
+    REQUIRE( mockArena.reallocationsInPlace() == 1 );
+
+    // Moving the second object down leaves 16 free bytes after it
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockRequester[1] == (void *)(arena + 8) );
+    void * previousC = mockRequester[2];
+
+    REQUIRE( mockArena.reallocate(mockRequester[1],16,24) == true );
+    REQUIRE( mockArena.reallocationsInPlace() == 2 );
+    REQUIRE( mockRequester[2] == previousC );
+
+    // Only the bytes which do not fit move the next objects
+    REQUIRE( mockArena.reallocate(mockRequester[1],24,40) == true );
+    REQUIRE( mockArena.reallocationsInPlace() == 2 );
+    REQUIRE( mockRequester[2] == (char *)previousC + 8 );
+    REQUIRE( mockRequester[3] == (char *)previousC + 8 + 16 );
+    REQUIRE( ((char *)mockRequester[2])[15] == 0x12 );
+    REQUIRE( ((char *)mockRequester[3])[0] == 0x13 );
+
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+    while(mockArena.compactStep(64) == false) {
+    }
+    REQUIRE( mockRequester[2] == (void *)(arena + 8 + 40) );
+    REQUIRE( ((char *)mockRequester[2])[0] == 0x12 );
+    REQUIRE( mockArena.elements() == 3 );
+}
+
+//
+// Ranges
+//
+
+
+TEST_CASE( "Remove range", "A range of bytes is removed with a single shift" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,10) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,4) == true );
+    for(uint32_t idx=0;idx<10;idx++) {
+        ((char *)mockRequester_a)[idx] = idx;
+    }
+    std::memset(mockRequester_b, 0x22, 4);
+
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester_a,8,3) == false );
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester_a,2,5) == true );
+    REQUIRE( mockArena.sizeElement(mockRequester_a) == 5 );
+    REQUIRE( ((char *)mockRequester_a)[1] == 1 );
+    REQUIRE( ((char *)mockRequester_a)[2] == 7 );
+    REQUIRE( ((char *)mockRequester_a)[4] == 9 );
+    REQUIRE( mockRequester_b == &arena[5] );
+    REQUIRE( ((char *)mockRequester_b)[3] == 0x22 );
+
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester_a,0,5) == true );
+    REQUIRE( mockArena.elements() == 1 );
+    REQUIRE( mockRequester_b == &arena[0] );
+}
+
+TEST_CASE( "Shrink", "Reallocating to a smaller size leaves the last bytes as slack" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,20) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,4) == true );
+    std::memset(mockRequester_a, 0x11, 20);
+    std::memset(mockRequester_b, 0x22, 4);
+
+    REQUIRE( mockArena.reallocate(mockRequester_a,20,12) == true );
+    REQUIRE( mockArena.sizeElement(mockRequester_a) == 12 );
+    REQUIRE( mockRequester_b == &arena[20] );
+    REQUIRE( mockArena.releasedBytes() == 8 );
+    REQUIRE( ((char *)mockRequester_a)[11] == 0x11 );
+    REQUIRE( mockArena.reallocate(mockRequester_a,12,0) == false );
+
+    // Shrinking the last object releases its bytes at once
+    REQUIRE( mockArena.reallocate(mockRequester_b,4,2) == true );
+    REQUIRE( mockArena.releasedBytes() == 8 );
+    mockArena.compact();
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockRequester_b == &arena[12] );
+    REQUIRE( ((char *)mockRequester_b)[1] == 0x22 );
+}
+
+TEST_CASE( "Shrink and release", "The slack goes with the last object" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,20) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,4) == true );
+    REQUIRE( mockArena.reallocate(mockRequester_a,20,12) == true );
+    REQUIRE( mockArena.releasedBytes() == 8 );
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_b) == true );
+    REQUIRE( mockArena.releasedBytes() == 8 );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockArena.elements() == 0 );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+
+    // The next object starts again at the beginning of the arena
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,8) == true );
+    REQUIRE( mockRequester_a == &arena[0] );
+}
+
+TEST_CASE( "Shrink and grow", "The slack of a shrunk object is reused in place" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,8) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b,32) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c,8) == true );
+    std::memset(mockRequester_b, 0x22, 32);
+    std::memset(mockRequester_c, 0x33, 8);
+    void * previousA = mockRequester_a;
+    void * previousB = mockRequester_b;
+    void * previousC = mockRequester_c;
+
+    REQUIRE( mockArena.reallocate(mockRequester_b,32,8) == true );
+    REQUIRE( mockArena.reallocate(mockRequester_b,8,4) == true );
+    REQUIRE( mockArena.sizeElement(mockRequester_b) == 4 );
+    REQUIRE( mockArena.releasedBytes() == 28 );
+    REQUIRE( mockRequester_c == previousC );
+
+    arch_t inPlace = mockArena.reallocationsInPlace();
+    REQUIRE( mockArena.reallocate(mockRequester_b,4,32) == true );
+    REQUIRE( mockArena.reallocationsInPlace() == inPlace + 1 );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockRequester_a == previousA );
+    REQUIRE( mockRequester_b == previousB );
+    REQUIRE( mockRequester_c == previousC );
+    REQUIRE( ((char *)mockRequester_b)[3] == 0x22 );
+    REQUIRE( ((char *)mockRequester_c)[7] == 0x33 );
+}
+
+TEST_CASE( "Pinned objects", "A pinned object keeps its address" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester[4];
+    for(uint32_t idx=0;idx<4;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],16) == true );
+        std::memset(mockRequester[idx], 0x10+idx, 16);
+    }
+    void * unknown = nullptr;
+    REQUIRE( mockArena.pin((arch_t)&unknown) == false );
+    REQUIRE( mockArena.pin((arch_t)&mockRequester[2]) == true );
+    REQUIRE( mockArena.isPinned((arch_t)&mockRequester[2]) == true );
+    REQUIRE( mockArena.isPinned((arch_t)&mockRequester[1]) == false );
+    REQUIRE( mockArena.sizeElement(mockRequester[2]) == 16 );
+
+    // The objects before the pinned one move, the rest stay
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    REQUIRE( mockRequester[1] == (void *)&arena[0] );
+    REQUIRE( mockRequester[2] == (void *)&arena[32] );
+    REQUIRE( mockRequester[3] == (void *)&arena[48] );
+    REQUIRE( ((char *)mockRequester[3])[0] == 0x13 );
+
+    // The free space before it can be used, but not more
+    REQUIRE( mockArena.reallocate(mockRequester[1],16,32) == true );
+    REQUIRE( mockArena.reallocate(mockRequester[1],32,40) == false );
+    REQUIRE( mockArena.sizeElement(mockRequester[1]) == 32 );
+    REQUIRE( mockRequester[2] == (void *)&arena[32] );
+
+    REQUIRE( mockArena.unpin((arch_t)&mockRequester[2]) == true );
+    REQUIRE( mockArena.reallocate(mockRequester[1],32,40) == true );
+    REQUIRE( mockRequester[2] == (void *)&arena[40] );
+    REQUIRE( mockRequester[3] == (void *)&arena[56] );
+    REQUIRE( ((char *)mockRequester[2])[15] == 0x12 );
+    REQUIRE( ((char *)mockRequester[3])[15] == 0x13 );
+}
+
+TEST_CASE( "Pinned compaction", "Objects are compacted around the pinned ones" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+
+    void * mockRequester[5];
+    for(uint32_t idx=0;idx<5;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],16) == true );
+        std::memset(mockRequester[idx], 0x10+idx, 16);
+    }
+    REQUIRE( mockArena.pin((arch_t)&mockRequester[4]) == true );
+    char * first = (char *)mockRequester[0];
+    void * pinned = mockRequester[4];
+    mockArena.updateDirtyMirror();
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    while(mockArena.compactStep(16) == false) {
+    }
+    REQUIRE( mockRequester[3] == (void *)(first + 32) );
+    REQUIRE( mockRequester[4] == pinned );
+    REQUIRE( mockArena.isPinned((arch_t)&mockRequester[4]) == true );
+
+    // The objects in the middle move into the free space before it
+    REQUIRE( mockArena.reallocate(mockRequester[1],16,24) == true );
+    REQUIRE( mockRequester[3] == (void *)(first + 40) );
+    REQUIRE( mockArena.reallocate(mockRequester[1],24,40) == false );
+    REQUIRE( ((char *)mockRequester[3])[15] == 0x13 );
+
+    // New objects go after it
+    void * mockRequesterNew;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequesterNew,mockRequesterNew,8) == true );
+    REQUIRE( mockRequesterNew == (char *)pinned + 16 );
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[2]) == true );
+    mockArena.compact();
+    REQUIRE( mockRequester[3] == (void *)(first + 24) );
+    REQUIRE( mockRequester[4] == pinned );
+    REQUIRE( ((char *)mockRequester[4])[0] == 0x14 );
+
+    // Deallocating it unpins it
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[4]) == true );
+    mockArena.compact();
+    REQUIRE( mockRequesterNew == (void *)(first + 40) );
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+TEST_CASE( "Relocation", "Objects which are not trivially copyable can be moved" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,16) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_b,mockRequester_b, \
+                2*sizeof(std::string)) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c, \
+                sizeof(std::string)) == true );
+    REQUIRE( cus::Relocation<uint32_t>::attach(mockArena,(arch_t)&mockRequester_a) == true );
+    REQUIRE( cus::Relocation<std::string>::attach(mockArena,(arch_t)&mockRequester_b) == true );
+    REQUIRE( cus::Relocation<std::string>::attach(mockArena,(arch_t)&mockRequester_c) == true );
+
+    // Short strings point to themselves, long ones to the heap
+    std::string *b = new (mockRequester_b) std::string("short");
+    new (b + 1) std::string(64,'x');
+    new (mockRequester_c) std::string("tail");
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockArena.compactStep(1) == false );
+    REQUIRE( mockArena.compactStep(1) == true );
+    REQUIRE( mockRequester_b == (void *)&arena[0] );
+    b = (std::string *)mockRequester_b;
+    REQUIRE( b[0] == "short" );
+    REQUIRE( b[1] == std::string(64,'x') );
+    REQUIRE( *(std::string *)mockRequester_c == "tail" );
+
+    // Growing the previous object moves the next one up
+    REQUIRE( mockArena.reallocate(mockRequester_b,2*sizeof(std::string), \
+                3*sizeof(std::string)) == true );
+    b = (std::string *)mockRequester_b;
+    new (b + 2) std::string("third");
+    REQUIRE( mockRequester_c == (void *)(b + 3) );
+    REQUIRE( *(std::string *)mockRequester_c == "tail" );
+
+    // The first string is destroyed before it is removed
+    b[0].~basic_string();
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester_b,0,sizeof(std::string)) == true );
+    b = (std::string *)mockRequester_b;
+    REQUIRE( b[0] == std::string(64,'x') );
+    REQUIRE( b[1] == "third" );
+    REQUIRE( *(std::string *)mockRequester_c == "tail" );
+
+    b[0].~basic_string();
+    b[1].~basic_string();
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_b) == true );
+    mockArena.compact();
+    REQUIRE( mockRequester_c == (void *)&arena[0] );
+    REQUIRE( *(std::string *)mockRequester_c == "tail" );
+    ((std::string *)mockRequester_c)->~basic_string();
+}
+
+TEST_CASE( "Aligned objects", "Aligned objects keep their alignment when they move" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (16)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester_a;
+    void * mockRequester_b;
+    void * mockRequester_c;
+    REQUIRE( mockArena.allocateAligned((arch_t)&mockRequester_a,mockRequester_a,8,3) == false );
+    REQUIRE( mockArena.allocateAligned((arch_t)&mockRequester_a,mockRequester_a,8, \
+                2*cus::BasicAllocation::MAX_ALIGNMENT) == false );
+    REQUIRE( mockArena.elements() == 0 );
+
+    // The bytes before an aligned object are left free
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,3) == true );
+    REQUIRE( mockArena.allocateAligned((arch_t)&mockRequester_b,mockRequester_b,16,16) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_c,mockRequester_c,5) == true );
+    REQUIRE( mockRequester_b == (void *)&arena[16] );
+    REQUIRE( mockRequester_c == (void *)&arena[32] );
+    std::memset(mockRequester_b, 0x22, 16);
+    std::memset(mockRequester_c, 0x33, 5);
+
+    // A growth within the free bytes does not move it, a bigger one moves
+    // it by a multiple of its alignment
+    REQUIRE( mockArena.reallocate(mockRequester_a,3,16) == true );
+    REQUIRE( mockRequester_b == (void *)&arena[16] );
+    REQUIRE( mockArena.reallocate(mockRequester_a,16,17) == true );
+    REQUIRE( mockRequester_b == (void *)&arena[32] );
+    REQUIRE( mockRequester_c == (void *)&arena[48] );
+    REQUIRE( ((char *)mockRequester_b)[15] == 0x22 );
+
+    // A removal before it moves it down only by a multiple of its alignment
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+    REQUIRE( mockRequester_b == (void *)&arena[16] );
+    REQUIRE( mockRequester_c == (void *)&arena[32] );
+    REQUIRE( ((char *)mockRequester_b)[0] == 0x22 );
+    REQUIRE( ((char *)mockRequester_c)[4] == 0x33 );
+
+    // The compactions keep it too
+    void * mockRequester_d;
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester_a,mockRequester_a,7) == true );
+    REQUIRE( mockArena.allocateAligned((arch_t)&mockRequester_d,mockRequester_d,8,8) == true );
+    REQUIRE( mockRequester_d == (void *)&arena[48] );
+    std::memset(mockRequester_d, 0x44, 8);
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_b) == true );
+    while(mockArena.compactStep(1) == false) {
+    }
+    REQUIRE( mockRequester_c == (void *)&arena[0] );
+    REQUIRE( mockRequester_a == (void *)&arena[5] );
+    REQUIRE( mockRequester_d == (void *)&arena[16] );
+    REQUIRE( ((char *)mockRequester_d)[7] == 0x44 );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_c) == true );
+    mockArena.compact();
+    REQUIRE( mockRequester_a == (void *)&arena[0] );
+    REQUIRE( mockRequester_d == (void *)&arena[8] );
+    REQUIRE( ((char *)mockRequester_d)[0] == 0x44 );
+}
+
+TEST_CASE( "Static arena", "The layout of the arena is known at compile time" ) {
+    typedef cus::StaticArena<512, 4, 16> Arena;
+    static_assert(Arena::indexBytes == 8*2*sizeof(arch_t), "Index of 8 slots");
+    static_assert(Arena::tableBytes == 4*3*sizeof(arch_t), "Table of 4 entries");
+    static_assert(Arena::dataBytes == 512 - 128 - 96, "Data under the table");
+    static_assert(Arena::tableOffset == 288 && Arena::indexOffset == 384, "Offsets");
+    static_assert(Arena::fits(288) && !Arena::fits(289), "Single object limit");
+
+    Arena mockArena;
+    REQUIRE( ((arch_t)mockArena.storage() % 16) == 0 );
+
+    void * mockRequester[5];
+    REQUIRE( mockArena.allocate<64>((arch_t)&mockRequester[0],mockRequester[0]) == true );
+    REQUIRE( mockRequester[0] == mockArena.storage() );
+    for(uint32_t idx=1;idx<4;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],32) == true );
+    }
+    // The number of objects is fixed
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester[4],mockRequester[4],8) == false );
+    REQUIRE( mockArena.elements() == 4 );
+
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    REQUIRE( mockRequester[1] == mockArena.storage() );
+    REQUIRE( mockArena.allocate<8>((arch_t)&mockRequester[4],mockRequester[4]) == true );
+    REQUIRE( mockArena.sizeElement(mockRequester[4]) == 8 );
+
+    // The table has no room for the entry of a deallocated object, even if
+    // the data has
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[2]) == true );
+    REQUIRE( mockArena.allocate<8>((arch_t)&mockRequester[0],mockRequester[0]) == true );
+    REQUIRE( mockArena.elements() == 4 );
+    REQUIRE( mockArena.exportMap().tableBytes == Arena::tableBytes );
+}
+
+TEST_CASE( "Static arena layout", "The runtime layout matches the compile time one" ) {
+    typedef cus::StaticArena<512, 4, 16> Arena;
+    Arena mockArena;
+
+    // The index is at the top of the section and the table is kept under it
+    cus::MapSummary summary = mockArena.exportMap();
+    REQUIRE( summary.arenaBytes == Arena::bytes - Arena::indexBytes );
+    REQUIRE( summary.arenaBytes == Arena::indexOffset );
+    REQUIRE( summary.tableBytes == 0 );
+    REQUIRE( summary.freeBytes == Arena::dataBytes );
+    // The binary map keeps the reserved table, so the free bytes agree
+    std::ostringstream binary;
+    mockArena.writeMapBinary(binary);
+    arch_t header[cus::MAP_HEADER_WORDS];
+    REQUIRE( binary.str().size() == sizeof(header) );
+    memcpy(header, binary.str().data(), sizeof(header));
+    REQUIRE( header[5] == Arena::tableBytes );
+    REQUIRE( header[1] - header[2] - header[5] == summary.freeBytes );
+
+    // The data does not grow into the unused entries
+    void * mockRequester_a;
+    void * mockRequester_b;
+    REQUIRE( mockArena.allocate<Arena::dataBytes>((arch_t)&mockRequester_a, \
+                mockRequester_a) == true );
+    REQUIRE( mockArena.allocate<8>((arch_t)&mockRequester_b,mockRequester_b) == false );
+    REQUIRE( mockArena.reallocate(mockRequester_a,Arena::dataBytes, \
+                Arena::dataBytes+8) == false );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester_a) == true );
+
+    // MaxObjects objects of dataBytes in total fill the section
+    void * mockRequester[4];
+    const std::size_t objectBytes = Arena::dataBytes/4;
+    for(uint32_t idx=0;idx<4;idx++) {
+        REQUIRE( mockArena.allocate<objectBytes>((arch_t)&mockRequester[idx], \
+                    mockRequester[idx]) == true );
+    }
+    REQUIRE( mockRequester[0] == mockArena.storage() );
+    REQUIRE( (uint8_t *)mockRequester[3] + objectBytes == \
+            (const uint8_t *)mockArena.storage() + Arena::dataBytes );
+    summary = mockArena.exportMap();
+    REQUIRE( summary.tableBytes == Arena::tableBytes );
+    REQUIRE( summary.dataBytes == Arena::dataBytes );
+    REQUIRE( summary.freeBytes == 0 );
+    const uint8_t *table = (const uint8_t *)mockArena.storage() + Arena::tableOffset;
+    REQUIRE( *(const arch_t *)(table + Arena::tableBytes - sizeof(arch_t)) == \
+            (arch_t)mockRequester[0] );
+
+    // The entries of deallocated objects are dropped when the table is full
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[1]) == true );
+    REQUIRE( mockArena.releasedBytes() == objectBytes );
+    REQUIRE( mockArena.allocate<8>((arch_t)&mockRequester[1],mockRequester[1]) == true );
+    REQUIRE( mockArena.elements() == 4 );
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( (uint8_t *)mockRequester[1] == (uint8_t *)mockRequester[3] + objectBytes );
+    summary = mockArena.exportMap();
+    REQUIRE( summary.tableBytes == Arena::tableBytes );
+    REQUIRE( summary.dataBytes == Arena::dataBytes - objectBytes + 8 );
+}
+
+TEST_CASE( "Statistics", "Operations, moved bytes and CRC work are counted" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester[3];
+    void * unknown = nullptr;
+    for(uint32_t idx=0;idx<3;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],16) == true );
+    }
+    REQUIRE( mockArena.allocate((arch_t)&unknown,unknown,1000) == false );
+    REQUIRE( mockArena.reallocate(mockRequester[0],16,24) == true );
+    REQUIRE( mockArena.reallocate(mockRequester[0],24,0) == false );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[1]) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&unknown) == false );
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester[0],0,8) == true );
+    REQUIRE( mockArena.removeRange((arch_t)&mockRequester[0],0,100) == false );
+    mockArena.compact();
+
+    char crcArena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockCrcArena(reinterpret_cast<void *>(&crcArena[0]), \
+                                   reinterpret_cast<void *>(&crcArena[END_ARENA]));
+    REQUIRE( mockCrcArena.allocate((arch_t)&mockRequester[1],mockRequester[1],16) == true );
+    mockCrcArena.updateMirror();
+    ((char *)mockRequester[1])[0] ^= 0x5A;
+    REQUIRE( mockCrcArena.checkConsistency() == true );
+
+    cus::AllocationStats stats = mockArena.stats();
+    cus::AllocationStats crcStats = mockCrcArena.stats();
+    if(cus::BasicAllocation::STATS_ENABLED == false) {
+        REQUIRE( stats.allocations == 0 );
+        REQUIRE( crcStats.crcBytes == 0 );
+        return;
+    }
+    REQUIRE( stats.allocations == 3 );
+    REQUIRE( stats.allocationFailures == 1 );
+    REQUIRE( stats.reallocations == 1 );
+    REQUIRE( stats.reallocationFailures == 1 );
+    REQUIRE( stats.deallocations == 1 );
+    REQUIRE( stats.deallocationFailures == 1 );
+    REQUIRE( stats.removals == 1 );
+    REQUIRE( stats.removalFailures == 1 );
+    REQUIRE( stats.compactions == 1 );
+    // The growth moves both next objects, the removals the next ones and
+    // the tail of the first one
+    REQUIRE( stats.reallocationBytesMoved == 32 );
+    REQUIRE( stats.removalBytesMoved == 16 + 32 );
+    REQUIRE( stats.highWaterData == 56 );
+    REQUIRE( stats.highWaterAddresses == 3*3*sizeof(arch_t) );
+    REQUIRE( stats.lookups == 5 );
+    REQUIRE( stats.lookupScanned >= stats.lookups );
+    REQUIRE( stats.crcBytes == 0 );
+
+    REQUIRE( crcStats.crcRestores == 1 );
+    REQUIRE( crcStats.crcFailures == 0 );
+    REQUIRE( crcStats.crcBytes > 0 );
+
+    mockArena.resetStats();
+    REQUIRE( mockArena.stats().allocations == 0 );
+}
+
+TEST_CASE( "Latency histogram", "Log buckets, percentiles and the recorded operations" ) {
+    cus::LatencyHistogram histogram;
+    REQUIRE( histogram.count() == 0 );
+    REQUIRE( histogram.percentile(50) == 0 );
+
+    // Exact under SUB_BUCKETS, then every bucket holds its own values
+    for(arch_t value=0;value<4096;value+=3) {
+        uint32_t bucket = cus::LatencyHistogram::bucketOf(value);
+        REQUIRE( bucket < cus::LatencyHistogram::BUCKETS );
+        REQUIRE( cus::LatencyHistogram::highestOf(bucket) >= value );
+        if(bucket > 0) {
+            REQUIRE( cus::LatencyHistogram::highestOf(bucket-1) < value );
+        }
+    }
+    REQUIRE( cus::LatencyHistogram::bucketOf(5) == 5 );
+    REQUIRE( cus::LatencyHistogram::bucketOf(~(arch_t)0) == \
+             cus::LatencyHistogram::BUCKETS-1 );
+
+    for(arch_t value=1;value<=1000;value++) {
+        histogram.record(value);
+    }
+    REQUIRE( histogram.count() == 1000 );
+    REQUIRE( histogram.min() == 1 );
+    REQUIRE( histogram.max() == 1000 );
+    // Relative error below 1/SUB_BUCKETS
+    REQUIRE( histogram.percentile(50) >= 500 );
+    REQUIRE( histogram.percentile(50) < 500 + 500/cus::LatencyHistogram::SUB_BUCKETS );
+    REQUIRE( histogram.percentile(99) >= 990 );
+    REQUIRE( histogram.percentile(100) == 1000 );
+    REQUIRE( histogram.percentile(0) == 1 );
+    histogram.reset();
+    REQUIRE( histogram.count() == 0 );
+
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[END_ARENA]));
+    // The constructor updates the mirror before the recording starts
+    cus::LatencyHistogram histograms[cus::BasicAllocation::LATENCY_OPERATIONS];
+    mockArena.enableLatency(histograms);
+    void * mockRequester[2];
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester[0],mockRequester[0],16) == true );
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester[1],mockRequester[1],16) == true );
+    REQUIRE( mockArena.reallocate(mockRequester[0],16,24) == true );
+    REQUIRE( mockArena.removeElement((arch_t)&mockRequester[0],mockRequester[0],8) == true );
+    mockArena.updateMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[1]) == true );
+
+    arch_t expected = cus::BasicAllocation::LATENCY_ENABLED ? 1 : 0;
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_ALLOCATE).count() == 2*expected );
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_REALLOCATE).count() == expected );
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_REMOVE_ELEMENT).count() == expected );
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_UPDATE_MIRROR).count() == expected );
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_CHECK_CONSISTENCY).count() == expected );
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_DEALLOCATE).count() == expected );
+    REQUIRE( histograms[cus::BasicAllocation::LATENCY_ALLOCATE].count() == 2*expected );
+    mockArena.resetLatency();
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_ALLOCATE).count() == 0 );
+
+    // Nothing is recorded once the histograms are taken away
+    mockArena.enableLatency(nullptr);
+    REQUIRE( mockArena.allocate((arch_t)&mockRequester[1],mockRequester[1],16) == true );
+    REQUIRE( histograms[cus::BasicAllocation::LATENCY_ALLOCATE].count() == 0 );
+    REQUIRE( mockArena.latency(cus::BasicAllocation::LATENCY_ALLOCATE).count() == 0 );
+}
+
+TEST_CASE( "Thread local arenas with latency", "The histograms are not part of the sub arenas" ) {
+    const uint32_t SIZE_SHARED=4096;
+    static char arena[SIZE_SHARED] __attribute__ ((aligned (8)));
+    cus::ThreadLocalAllocation mockArenas(reinterpret_cast<void *>(&arena[0]), \
+                                          reinterpret_cast<void *>(&arena[SIZE_SHARED]), 2);
+    REQUIRE( mockArenas.available() == 2 );
+
+    cus::LatencyHistogram histograms[cus::BasicAllocation::LATENCY_OPERATIONS];
+    cus::BasicAllocation *threadArena = nullptr;
+    bool allocated = false;
+    std::thread first([&]() {
+        threadArena = mockArenas.local();
+        void * mockRequester;
+        if(threadArena != nullptr) {
+            threadArena->enableLatency(histograms);
+            allocated = threadArena->allocate((arch_t)&mockRequester,mockRequester,16);
+            threadArena->deallocate((arch_t)&mockRequester);
+            threadArena->enableLatency(nullptr);
+        }
+    });
+    first.join();
+    REQUIRE( threadArena != nullptr );
+    REQUIRE( allocated == true );
+
+    arch_t expected = cus::BasicAllocation::LATENCY_ENABLED ? 1 : 0;
+    REQUIRE( histograms[cus::BasicAllocation::LATENCY_ALLOCATE].count() == expected );
+    REQUIRE( histograms[cus::BasicAllocation::LATENCY_DEALLOCATE].count() == expected );
+    mockArenas.release();
+}
+
+TEST_CASE( "Map export", "Entries, fragmentation and the JSON and binary writers" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    void * mockRequester[4];
+    for(uint32_t idx=0;idx<4;idx++) {
+        REQUIRE( mockArena.allocate((arch_t)&mockRequester[idx],mockRequester[idx],16) == true );
+    }
+    // A hole before the pinned object, and a dead one after it
+    REQUIRE( mockArena.pin((arch_t)&mockRequester[1]) == true );
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[0]) == true );
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(101);
+    REQUIRE( mockArena.deallocate((arch_t)&mockRequester[2]) == true );
+
+    std::vector<cus::MapEntry> entries;
+    cus::MapSummary summary = mockArena.exportMap([](const cus::MapEntry& entry, \
+                void *context) {
+        ((std::vector<cus::MapEntry> *)context)->push_back(entry);
+    }, &entries);
+    REQUIRE( summary.objects == 3 );
+    REQUIRE( summary.arenaBytes == END_ARENA );
+    REQUIRE( summary.dataBytes == 64 );
+    REQUIRE( summary.tableBytes == 3*3*sizeof(arch_t) );
+    REQUIRE( summary.freeBytes == END_ARENA - 64 - 3*3*sizeof(arch_t) );
+    REQUIRE( summary.liveBytes == 32 );
+    REQUIRE( summary.deadBytes == 16 );
+    REQUIRE( summary.gapBytes == 16 );
+    REQUIRE( summary.fragmentation == 0.5 );
+
+    REQUIRE( entries.size() == 3 );
+    REQUIRE( entries[0].dataOffset == 16 );
+    REQUIRE( entries[0].requester == (arch_t)&mockRequester[1] );
+    REQUIRE( entries[0].pinned == true );
+    REQUIRE( entries[1].dead == true );
+    REQUIRE( entries[1].requester == 0 );
+    REQUIRE( entries[2].dataOffset == 48 );
+    REQUIRE( entries[2].pinned == false );
+    REQUIRE( entries[2].dead == false );
+
+    std::ostringstream json;
+    mockArena.writeMapJson(json);
+    std::ostringstream expected;
+    expected << "{\"objects\":[{\"offset\":16,\"size\":16,\"requester\":" \
+             << (arch_t)&mockRequester[1] << ",\"pinned\":true,\"dead\":false}," \
+             << "{\"offset\":32,\"size\":16,\"requester\":0,\"pinned\":false,\"dead\":true}," \
+             << "{\"offset\":48,\"size\":16,\"requester\":" << (arch_t)&mockRequester[3] \
+             << ",\"pinned\":false,\"dead\":false}],\"arena_bytes\":" << END_ARENA \
+             << ",\"data_bytes\":64,\"table_bytes\":72,\"free_bytes\":" \
+             << END_ARENA - 64 - 72 << ",\"live_bytes\":32,\"dead_bytes\":16," \
+             << "\"gap_bytes\":16,\"fragmentation\":0.5}\n";
+    REQUIRE( json.str() == expected.str() );
+
+    std::ostringstream binary;
+    mockArena.writeMapBinary(binary);
+    std::string bytes = binary.str();
+    REQUIRE( bytes.size() == (cus::MAP_HEADER_WORDS + 3*cus::MAP_ENTRY_WORDS)*sizeof(arch_t) );
+    arch_t words[cus::MAP_HEADER_WORDS + 3*cus::MAP_ENTRY_WORDS];
+    memcpy(words, bytes.data(), sizeof(words));
+    REQUIRE( (uint32_t)words[0] == cus::MAP_MAGIC );
+    REQUIRE( (words[0] >> 32) == cus::MAP_VERSION );
+    REQUIRE( words[1] == END_ARENA );
+    REQUIRE( words[2] == 64 );
+    REQUIRE( words[4] == 3 );
+    REQUIRE( words[5] == 0 );
+    REQUIRE( words[cus::MAP_HEADER_WORDS + 1] == (16 | cus::MAP_PINNED) );
+    REQUIRE( words[cus::MAP_HEADER_WORDS + cus::MAP_ENTRY_WORDS + 2] == 0 );
+    REQUIRE( words[cus::MAP_HEADER_WORDS + 2*cus::MAP_ENTRY_WORDS] == 48 );
+}
@@ -0,0 +1,86 @@
+// Let Catch provide main():
+#define CATCH_CONFIG_MAIN
+
+
+#include "catch2/catch.hpp"
+#include <cstring>
+#include <mgmt.hpp>
+
+const uint32_t SIZE_BUFFER=1024;
+
+static void fillPattern(uint8_t *buffer, uint32_t size) {
+    for(uint32_t idx=0;idx<size;idx++) {
+        buffer[idx] = (uint8_t)(idx*31 + 7);
+    }
+}
+
+TEST_CASE( "Copy", "memcpy2 copies non overlapped areas of any size" ) {
+    MemoryMgmt mgmt;
+    uint8_t src[SIZE_BUFFER];
+    uint8_t dest[SIZE_BUFFER];
+    fillPattern(src, SIZE_BUFFER);
+
+    for(uint32_t len=0;len<600;len+=7) {
+        for(uint32_t offset=0;offset<16;offset+=3) {
+            std::memset(dest, 0, SIZE_BUFFER);
+            mgmt.memcpy2(&dest[offset], &src[16-offset], len);
+            REQUIRE( std::memcmp(&dest[offset], &src[16-offset], len) == 0 );
+            REQUIRE( dest[offset+len] == 0 );
+        }
+    }
+}
+
+TEST_CASE( "Overlapped copy", "memcpy2 behaves like memmove" ) {
+    MemoryMgmt mgmt;
+    uint8_t buffer[SIZE_BUFFER];
+    uint8_t expected[SIZE_BUFFER];
+
+    for(uint32_t len=1;len<700;len+=13) {
+        for(int32_t shift=-70;shift<=70;shift+=3) {
+            uint32_t from = 200;
+            uint32_t to = from + shift;
+            fillPattern(buffer, SIZE_BUFFER);
+            fillPattern(expected, SIZE_BUFFER);
+            std::memmove(&expected[to], &expected[from], len);
+
+            mgmt.memcpy2(&buffer[to], &buffer[from], len);
+            REQUIRE( std::memcmp(buffer, expected, SIZE_BUFFER) == 0 );
+        }
+    }
+}
+
+TEST_CASE( "Mirror copy", "memcpyMirror writes the inverted bytes" ) {
+    MemoryMgmt mgmt;
+    uint8_t buffer[SIZE_BUFFER];
+    uint8_t expected[SIZE_BUFFER];
+
+    for(uint32_t len=0;len<400;len+=11) {
+        for(int32_t shift=-300;shift<=300;shift+=50) {
+            uint32_t from = 300;
+            uint32_t to = from + shift;
+            fillPattern(buffer, SIZE_BUFFER);
+            fillPattern(expected, SIZE_BUFFER);
+            uint8_t original[SIZE_BUFFER];
+            std::memcpy(original, expected, SIZE_BUFFER);
+            for(uint32_t idx=0;idx<len;idx++) {
+                expected[to+idx] = (uint8_t)~original[from+idx];
+            }
+
+            mgmt.memcpyMirror(&buffer[to], &buffer[from], len);
+            REQUIRE( std::memcmp(buffer, expected, SIZE_BUFFER) == 0 );
+        }
+    }
+}
+
+TEST_CASE( "Check mirror", "An inverted copy has no mismatches" ) {
+    MemoryMgmt mgmt;
+    uint8_t src[SIZE_BUFFER];
+    uint8_t mirror[SIZE_BUFFER];
+    fillPattern(src, SIZE_BUFFER);
+
+    mgmt.memcpyMirror(mirror, src, SIZE_BUFFER);
+    REQUIRE( mgmt.checkMirror(src, mirror, SIZE_BUFFER) == 0 );
+
+    mirror[100] = src[100];
+    REQUIRE( mgmt.checkMirror(src, mirror, SIZE_BUFFER) == 1 );
+}
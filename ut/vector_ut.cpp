@@ -5,6 +5,10 @@
 #include "catch2/catch.hpp"
 #include <allocator.hpp>
 #include <vector.hpp>
+#include <inline_vector.hpp>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
 
 const uint32_t SIZE_ARENA=500;
 const uint32_t END_ARENA=500;
@@ -161,6 +165,9 @@ TEST_CASE( "Different types", "Different types of vectors can be created" ) {
         vectorB.~Vector();
         vectorF.~Vector();
         vectorA.~Vector();
+        vectorD.shrink_to_fit();
+        vectorC.shrink_to_fit();
+        vectorE.shrink_to_fit();
     }
     for(uint32_t i = 0;i<vectorD.size();i++) {
         REQUIRE( vectorD[i] == (uint8_t)i+3);
@@ -186,3 +193,685 @@ TEST_CASE( "Different types", "Different types of vectors can be created" ) {
 }
 
 
+
+TEST_CASE( "Geometric growth", "The capacity grows geometrically when appending" ) {
+    char arena[SIZE_ARENA];
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::Vector<uint8_t> vector(mockArena);
+    REQUIRE( vector.capacity() == 0 );
+
+    uint32_t expectedCapacity[] = {1,2,4,4,8,8,8,8,16};
+    for(uint32_t i=0;i<9;i++) {
+        REQUIRE( vector.push_back(uint8_t(i)) == false );
+        REQUIRE( vector.capacity() == expectedCapacity[i] );
+    }
+    for(uint32_t i=0;i<9;i++) {
+        REQUIRE( vector[i] == i );
+    }
+
+    cus::Vector<uint8_t> linear(mockArena);
+    REQUIRE( linear.setGrowthFactor(1.0f) == false );
+    REQUIRE( linear.setGrowthFactor(std::nanf("")) == false );
+    REQUIRE( linear.setGrowthFactor(INFINITY) == false );
+    REQUIRE( linear.setGrowthFactor(1.5f) == true );
+    uint32_t expectedLinear[] = {1,2,3,4,6,6,9,9,9};
+    for(uint32_t i=0;i<9;i++) {
+        REQUIRE( linear.push_back(uint8_t(i)) == false );
+        REQUIRE( linear.capacity() == expectedLinear[i] );
+    }
+
+    // The geometric capacity saturates and does not fit, so only the
+    // needed element is added
+    cus::Vector<uint8_t> huge(mockArena,{1,2});
+    REQUIRE( huge.setGrowthFactor(3.0e38f) == true );
+    REQUIRE( huge.push_back(uint8_t(3)) == false );
+    REQUIRE( huge.capacity() == 3 );
+}
+
+TEST_CASE( "Growth fills the arena", "When the geometric growth does not fit, \
+        the vector grows only the needed elements" ) {
+    char arena[SIZE_ARENA];
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::Vector<uint8_t> vector(mockArena);
+
+    uint32_t i=0;
+    while(vector.push_back(uint8_t(i)) == false) {
+        i++;
+    }
+    REQUIRE( vector.isJeopardized() == true );
+    REQUIRE( i == ((SIZE_ARENA)-3*sizeof(arch_t)) );
+    REQUIRE( vector.capacity() == vector.size() );
+}
+
+TEST_CASE( "Reserve", "Reserved elements do not move the arena when appending" ) {
+    char arena[SIZE_ARENA];
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::Vector<uint16_t> vectorA(mockArena);
+    cus::Vector<uint16_t> vectorB(mockArena);
+
+    REQUIRE( vectorA.reserve(32) == false );
+    REQUIRE( vectorA.capacity() == 32 );
+    REQUIRE( vectorA.size() == 0 );
+
+    vectorB.push_back(uint16_t(0xA5A5));
+    const uint16_t *firstB = &vectorB[0];
+
+    for(uint16_t i=0;i<32;i++) {
+        vectorA.push_back(i);
+    }
+    REQUIRE( vectorA.capacity() == 32 );
+    REQUIRE( &vectorB[0] == firstB );
+    REQUIRE( vectorB[0] == 0xA5A5 );
+
+    // Reserve never reduces the capacity
+    REQUIRE( vectorA.reserve(4) == false );
+    REQUIRE( vectorA.capacity() == 32 );
+}
+
+TEST_CASE( "Shrink to fit", "Unused capacity is given back to the arena" ) {
+    char arena[SIZE_ARENA];
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::Vector<uint8_t> vectorA(mockArena);
+    cus::Vector<uint8_t> vectorB(mockArena);
+
+    vectorA.reserve(100);
+    for(uint8_t i=0;i<10;i++) {
+        vectorA.push_back(i);
+    }
+    vectorB.push_back(uint8_t(0x5A));
+    REQUIRE( &vectorB[0] == &vectorA[0] + 100 );
+
+    REQUIRE( vectorA.shrink_to_fit() == false );
+    REQUIRE( vectorA.capacity() == 10 );
+    REQUIRE( &vectorB[0] == &vectorA[0] + 10 );
+    REQUIRE( vectorB[0] == 0x5A );
+    for(uint8_t i=0;i<10;i++) {
+        REQUIRE( vectorA[i] == i );
+    }
+
+    for(uint8_t i=0;i<10;i++) {
+        vectorA.erase(0);
+    }
+    REQUIRE( vectorA.shrink_to_fit() == false );
+    REQUIRE( vectorA.capacity() == 0 );
+    REQUIRE( mockArena.elements() == 1 );
+    REQUIRE( vectorA.push_back(uint8_t(1)) == false );
+    REQUIRE( vectorA[0] == 1 );
+}
+
+TEST_CASE( "Crc vector", "Appends and erases keep the mirror up to date" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::CrcVector<uint16_t> vectorA(mockArena);
+    cus::CrcVector<uint16_t> vectorB(mockArena);
+
+    for(uint16_t i=0;i<20;i++) {
+        REQUIRE( vectorA.push_back(i) == false );
+        REQUIRE( vectorB.push_back(uint16_t(100+i)) == false );
+    }
+    vectorA.erase(3);
+    vectorA.erase(0);
+    REQUIRE( vectorA.size() == 18 );
+    REQUIRE( vectorA[0] == 1 );
+    REQUIRE( vectorA[2] == 4 );
+    REQUIRE( mockArena.checkConsistency() == true );
+
+    // A corruption in the original copy is restored with the next append
+    uint16_t *first = (uint16_t *)&vectorB[0];
+    *first = 0xDEAD;
+    REQUIRE( vectorB.push_back(uint16_t(120)) == false );
+    REQUIRE( vectorB[0] == 100 );
+    REQUIRE( vectorB[20] == 120 );
+}
+
+TEST_CASE( "Crc vector erased to empty", "The object is released by shrink_to_fit()" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::CrcVector<uint16_t> vectorA(mockArena);
+    bool erased;
+    for(uint16_t idx=0;idx<10;idx++) {
+        REQUIRE( vectorA.push_back(idx) == false );
+        REQUIRE( vectorA.capacity() == 1 );
+        if((idx%2)==0) {
+            vectorA.erase(0);
+        } else {
+            vectorA.erase(0, erased);
+            REQUIRE( erased == true );
+        }
+        REQUIRE( vectorA.size() == 0 );
+        REQUIRE( vectorA.capacity() == 1 );
+        REQUIRE( mockArena.elements() == 1 );
+        REQUIRE( vectorA.shrink_to_fit() == false );
+        REQUIRE( vectorA.data() == nullptr );
+        REQUIRE( mockArena.elements() == 0 );
+        REQUIRE( mockArena.checkConsistency() == true );
+    }
+}
+
+TEST_CASE( "Crc vector batch", "A batch checks and mirrors the arena once" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::CrcVector<uint16_t> vectorA(mockArena);
+    REQUIRE( vectorA.push_back(uint16_t(100)) == false );
+
+    // A corruption before the batch is restored when it is opened
+    uint16_t *first = (uint16_t *)&vectorA[0];
+    *first = 0xDEAD;
+    {
+        cus::CrcBatch batch(mockArena);
+        REQUIRE( batch.isConsistent() == true );
+        REQUIRE( vectorA[0] == 100 );
+        {
+            cus::CrcBatch nested(mockArena);
+            for(uint16_t i=1;i<30;i++) {
+                REQUIRE( vectorA.push_back(uint16_t(100+i)) == false );
+            }
+        }
+        vectorA.erase(5);
+        REQUIRE( mockArena.checkConsistency() == true );
+    }
+    REQUIRE( vectorA.size() == 29 );
+    REQUIRE( vectorA[5] == 106 );
+
+    // The mirror is valid once the batch is closed
+    first = (uint16_t *)&vectorA[0];
+    *first = 0xDEAD;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[0] == 100 );
+}
+
+TEST_CASE( "Erase range", "A range of elements is removed at once" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::Vector<uint16_t> vectorA(mockArena);
+    cus::Vector<uint16_t> vectorB(mockArena,{7,8});
+    for(uint16_t i=0;i<10;i++) {
+        vectorA.push_back(i);
+    }
+    uint32_t capacityA = vectorA.capacity();
+
+    vectorA.erase(2,6);
+    REQUIRE( vectorA.size() == 6 );
+    REQUIRE( vectorA.capacity() == capacityA );
+    REQUIRE( vectorA[1] == 1 );
+    REQUIRE( vectorA[2] == 6 );
+    REQUIRE( vectorA[5] == 9 );
+    REQUIRE( vectorB[1] == 8 );
+
+    // Nothing is removed out of the boundaries
+    vectorA.erase(4,7);
+    REQUIRE( vectorA.size() == 6 );
+
+    vectorB.erase(0,2);
+    REQUIRE( vectorB.size() == 0 );
+    REQUIRE( vectorB.capacity() == 2 );
+    REQUIRE( vectorB.push_back(uint16_t(3)) == false );
+    REQUIRE( vectorB[0] == 3 );
+
+    // The capacity is given back by shrink_to_fit()
+    REQUIRE( vectorA.shrink_to_fit() == false );
+    REQUIRE( vectorA.capacity() == 6 );
+    REQUIRE( vectorA[5] == 9 );
+    REQUIRE( vectorB[0] == 3 );
+    REQUIRE( vectorA.isJeopardized() == false );
+}
+
+TEST_CASE( "Crc erase range", "Erasing a range keeps the mirror up to date" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::CrcVector<uint16_t> vectorA(mockArena,{0,1,2,3,4,5});
+    vectorA.erase(1,4);
+    REQUIRE( vectorA.size() == 3 );
+    REQUIRE( vectorA[1] == 4 );
+
+    uint16_t *first = (uint16_t *)&vectorA[0];
+    *first = 0xDEAD;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[0] == 0 );
+}
+
+TEST_CASE( "Bulk append", "Elements are appended, inserted and assigned at once" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    const uint16_t values[5] = {10,11,12,13,14};
+    cus::Vector<uint16_t> vectorA(mockArena,{1,2});
+    cus::Vector<uint16_t> vectorB(mockArena,{7,8});
+    REQUIRE( vectorA.capacity() == 2 );
+
+    REQUIRE( vectorA.append(values,5) == false );
+    REQUIRE( vectorA.size() == 7 );
+    REQUIRE( vectorA[2] == 10 );
+    REQUIRE( vectorA[6] == 14 );
+
+    REQUIRE( vectorA.insert(1,&values[0],&values[2]) == false );
+    REQUIRE( vectorA.size() == 9 );
+    REQUIRE( vectorA[0] == 1 );
+    REQUIRE( vectorA[1] == 10 );
+    REQUIRE( vectorA[2] == 11 );
+    REQUIRE( vectorA[3] == 2 );
+    REQUIRE( vectorA[8] == 14 );
+    REQUIRE( vectorB[1] == 8 );
+
+    // The source moves when the arena grows, so it is reserved first
+    REQUIRE( vectorB.push_back(vectorA) == false );
+    REQUIRE( vectorB.size() == 11 );
+    REQUIRE( vectorB[2] == 1 );
+    REQUIRE( vectorB[10] == 14 );
+
+    REQUIRE( vectorA.assign(&values[3],&values[5]) == false );
+    REQUIRE( vectorA.size() == 2 );
+    REQUIRE( vectorA[0] == 13 );
+    REQUIRE( vectorA.insert(5,&values[0],&values[1]) == true );
+}
+
+TEST_CASE( "Crc bulk append", "Bulk appends keep the mirror up to date" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    const uint16_t values[4] = {10,11,12,13};
+    cus::CrcVector<uint16_t> vectorA(mockArena,{1,2});
+    cus::CrcVector<uint16_t> vectorB(mockArena,{7,8});
+    REQUIRE( vectorA.append(values,4) == false );
+    REQUIRE( vectorA.insert(0,&values[2],&values[4]) == false );
+    REQUIRE( vectorA.push_back(vectorB) == false );
+    REQUIRE( vectorA.size() == 10 );
+    REQUIRE( vectorA[0] == 12 );
+    REQUIRE( vectorA[2] == 1 );
+    REQUIRE( vectorA[9] == 8 );
+
+    uint16_t *first = (uint16_t *)&vectorA[9];
+    *first = 0xDEAD;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[9] == 8 );
+}
+
+TEST_CASE( "Self insert", "A range of the vector can be inserted into itself" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::PoolAllocation mockPool(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_ARENA/2]));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[SIZE_ARENA/2]), \
+                                 reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    // The growth moves vectorA to a block of a bigger class
+    cus::Vector<uint32_t> vectorA(mockPool,{1,2,3});
+    const uint32_t *previous = vectorA.data();
+    REQUIRE( vectorA.insert(0, vectorA.data()+1, vectorA.data()+3) == false );
+    REQUIRE( vectorA.data() != previous );
+    const uint32_t expectedA[5] = {2,3,1,2,3};
+    REQUIRE( std::equal(vectorA.begin(), vectorA.end(), expectedA) );
+
+    // The range is split by the insertion point
+    REQUIRE( vectorA.insert(2, vectorA.data()+1, vectorA.data()+4) == false );
+    const uint32_t expectedB[8] = {2,3,3,1,2,1,2,3};
+    REQUIRE( vectorA.size() == 8 );
+    REQUIRE( std::equal(vectorA.begin(), vectorA.end(), expectedB) );
+
+    cus::CrcVector<uint16_t> vectorB(mockArena,{1,2,3});
+    cus::CrcVector<uint16_t> vectorC(mockArena,{7});
+    REQUIRE( vectorB.insert(1, vectorB.data(), vectorB.data()+3) == false );
+    const uint16_t expectedC[6] = {1,1,2,3,2,3};
+    REQUIRE( std::equal(vectorB.begin(), vectorB.end(), expectedC) );
+    REQUIRE( vectorC[0] == 7 );
+    REQUIRE( mockArena.checkConsistency() == true );
+
+    // A range of the vector itself is assigned without growing
+    const uint32_t *before = vectorA.data();
+    REQUIRE( vectorA.assign(vectorA.data()+5, vectorA.data()+8) == false );
+    REQUIRE( vectorA.data() == before );
+    REQUIRE( vectorA.size() == 3 );
+    REQUIRE( std::equal(vectorA.begin(), vectorA.end(), &expectedB[5]) );
+
+    REQUIRE( vectorB.assign(vectorB.data()+2, vectorB.data()+5) == false );
+    const uint16_t expectedD[3] = {2,3,2};
+    REQUIRE( vectorB.size() == 3 );
+    REQUIRE( std::equal(vectorB.begin(), vectorB.end(), expectedD) );
+    REQUIRE( vectorC[0] == 7 );
+    REQUIRE( mockArena.checkConsistency() == true );
+}
+
+TEST_CASE( "Direct access", "Elements are used as a contiguous array" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::Vector<uint32_t> vectorA(mockArena,{5,3,9,1,7});
+    const cus::Vector<uint32_t>& constA = vectorA;
+    REQUIRE( vectorA.data() == &vectorA[0] );
+    REQUIRE( vectorA.end() - vectorA.begin() == 5 );
+    REQUIRE( std::accumulate(constA.begin(),constA.end(),0u) == 25 );
+
+    std::sort(vectorA.begin(),vectorA.end());
+    REQUIRE( vectorA[0] == 1 );
+    REQUIRE( vectorA[4] == 9 );
+
+    cus::Span<uint32_t> all = vectorA.span();
+    REQUIRE( all.size() == 5 );
+    REQUIRE( all[2] == 5 );
+    cus::Span<uint32_t> tail = all.subspan(3,2);
+    REQUIRE( tail[0] == 7 );
+    tail[1] = 11;
+    REQUIRE( vectorA[4] == 11 );
+
+    uint32_t visited = 0;
+    for (uint32_t value : constA.span()) {
+        visited += value;
+    }
+    REQUIRE( visited == 27 );
+}
+
+TEST_CASE( "Crc direct access", "Writes through data() are notified to the mirror" ) {
+    char arena[SIZE_ARENA] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[END_ARENA]));
+
+    cus::CrcVector<uint16_t> vectorA(mockArena,{4,3,2,1});
+    std::reverse(vectorA.begin(),vectorA.end());
+    mockArena.markDirty(vectorA.data(),vectorA.size()*sizeof(uint16_t));
+    mockArena.updateDirtyMirror();
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[0] == 1 );
+    REQUIRE( vectorA[3] == 4 );
+}
+
+struct Sample {
+    int32_t x;
+    int32_t y;
+    char tag;
+};
+
+TEST_CASE( "Inline vector", "Header only vector for trivially copyable types" ) {
+    // A multiple of the word, so the address table is aligned
+    const uint32_t SIZE_INLINE=512;
+    char arena[SIZE_INLINE] __attribute__ ((aligned (8)));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[SIZE_INLINE]));
+
+    cus::InlineVector<Sample> samples(mockArena);
+    cus::InlineVector<uint16_t> values(mockArena,{1,2,3});
+    for(int32_t idx=0;idx<5;idx++) {
+        REQUIRE( samples.push_back({idx, -idx, (char)('a'+idx)}) == false );
+    }
+    REQUIRE( samples.size() == 5 );
+    REQUIRE( samples.capacity() >= 5 );
+    REQUIRE( samples[3].y == -3 );
+    REQUIRE( samples[4].tag == 'e' );
+
+    // The next object moves when the first one grows
+    REQUIRE( values.push_back(4) == false );
+    REQUIRE( values[3] == 4 );
+    REQUIRE( values.reserve(16) == false );
+    REQUIRE( values.capacity() == 16 );
+    REQUIRE( samples[4].x == 4 );
+
+    samples.erase(1,3);
+    REQUIRE( samples.size() == 3 );
+    REQUIRE( samples[1].x == 3 );
+    samples[1].x = 30;
+    REQUIRE( samples.data()[1].x == 30 );
+
+    bool outOfBoundaries;
+    REQUIRE( values.at(2,outOfBoundaries) == 3 );
+    REQUIRE( outOfBoundaries == false );
+    values.at(4,outOfBoundaries);
+    REQUIRE( outOfBoundaries == true );
+
+    REQUIRE( values.shrink_to_fit() == false );
+    REQUIRE( values.capacity() == 4 );
+    uint32_t total = 0;
+    for(uint16_t value : values) {
+        total += value;
+    }
+    REQUIRE( total == 10 );
+}
+
+TEST_CASE( "Crc inline vector", "The crc policy keeps the mirror up to date" ) {
+    // A multiple of the word, so the address table is aligned
+    const uint32_t SIZE_INLINE=512;
+    char arena[SIZE_INLINE] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                   reinterpret_cast<void *>(&arena[SIZE_INLINE]));
+
+    cus::InlineVector<uint32_t, cus::CrcPolicy> vectorA(mockArena,{1,2});
+    cus::InlineVector<uint32_t, cus::CrcPolicy> vectorB(mockArena,{7});
+    const uint32_t values[3] = {3,4,5};
+    REQUIRE( vectorA.append(values,3) == false );
+    REQUIRE( vectorA.push_back(6) == false );
+    REQUIRE( vectorA.size() == 6 );
+    REQUIRE( vectorB[0] == 7 );
+    vectorA.erase(0);
+    REQUIRE( vectorA[0] == 2 );
+
+    uint32_t *first = &vectorA[4];
+    *first = 0xDEAD;
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[4] == 6 );
+    REQUIRE( vectorB[0] == 7 );
+}
+
+TEST_CASE( "Crc ranged checks", "A change only checks the blocks it writes" ) {
+    const uint32_t SIZE_CRC=2048;
+    const uint32_t BLOCK=64;
+    char arena[SIZE_CRC] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_CRC]), BLOCK);
+
+    cus::CrcVector<uint32_t> vectorA(mockArena);
+    cus::CrcVector<uint32_t> vectorB(mockArena);
+    REQUIRE( vectorA.reserve(2*BLOCK/sizeof(uint32_t)) == false );
+    for(uint32_t idx=0;idx<2*BLOCK/sizeof(uint32_t);idx++) {
+        REQUIRE( vectorA.push_back(idx) == false );
+    }
+    REQUIRE( vectorB.reserve(4) == false );
+
+    // Only the copy of the first block of vectorA is corrupted. Neither the
+    // appends nor the growth nor the removals of vectorB go through it
+    uint8_t *corrupted = (uint8_t *)(vectorA.data() + 1);
+    *corrupted ^= 0xFF;
+    cus::AllocationStats before = mockArena.stats();
+    for(uint32_t idx=0;idx<3*BLOCK/sizeof(uint32_t);idx++) {
+        REQUIRE( vectorB.push_back(idx) == false );
+    }
+    vectorB.erase(0);
+    vectorB.erase(0,4);
+    REQUIRE( vectorB.shrink_to_fit() == false );
+    REQUIRE( vectorB.size() == 3*BLOCK/sizeof(uint32_t) - 5 );
+    REQUIRE( vectorB[0] == 5 );
+    REQUIRE( *corrupted == (1 ^ 0xFF) );
+    if(cus::BasicAllocation::STATS_ENABLED) {
+        REQUIRE( mockArena.stats().crcRestores == before.crcRestores );
+    }
+
+    // A change of vectorA checks the blocks it moves and restores them
+    vectorA.erase(0);
+    REQUIRE( vectorA[0] == 1 );
+    REQUIRE( mockArena.checkConsistency() == true );
+
+    // The corruption of the written blocks is still found
+    vectorB.data()[vectorB.size()-1] ^= 0xFF00;
+    REQUIRE( vectorB.push_back(99) == false );
+    REQUIRE( vectorB[vectorB.size()-2] == 3*BLOCK/sizeof(uint32_t) - 1 );
+}
+
+TEST_CASE( "Crc destroy and mutate", "Destroyed vectors leave the mirror up to date" ) {
+    const uint32_t SIZE_CRC=4096;
+    const uint32_t ELEMENTS=40;
+    char arena[SIZE_CRC] __attribute__ ((aligned (8)));
+    for(uint32_t blockSize : {0u, 256u}) {
+        cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                     reinterpret_cast<void *>(&arena[SIZE_CRC]), blockSize);
+
+        // The next objects move down when the first one is destroyed
+        cus::CrcVector<uint32_t> vectorB(mockArena);
+        cus::InlineVector<uint32_t, cus::CrcPolicy> inlineB(mockArena);
+        {
+            cus::CrcVector<uint32_t> vectorA(mockArena);
+            cus::InlineVector<uint32_t, cus::CrcPolicy> inlineA(mockArena);
+            for(uint32_t idx=0;idx<ELEMENTS;idx++) {
+                REQUIRE( vectorA.push_back(idx) == false );
+                REQUIRE( inlineA.push_back(idx) == false );
+                REQUIRE( vectorB.push_back(100+idx) == false );
+                REQUIRE( inlineB.push_back(200+idx) == false );
+            }
+        }
+        REQUIRE( vectorB.push_back(7) == false );
+        REQUIRE( inlineB.push_back(8) == false );
+        for(uint32_t idx=0;idx<ELEMENTS;idx++) {
+            REQUIRE( vectorB[idx] == 100+idx );
+            REQUIRE( inlineB[idx] == 200+idx );
+        }
+        REQUIRE( vectorB[ELEMENTS] == 7 );
+        REQUIRE( inlineB[ELEMENTS] == 8 );
+        REQUIRE( vectorB.isJeopardized() == false );
+        REQUIRE( mockArena.checkConsistency() == true );
+        if(cus::BasicAllocation::STATS_ENABLED) {
+            REQUIRE( mockArena.stats().crcRestores == 0 );
+        }
+    }
+}
+
+TEST_CASE( "Crc destroy and compact", "A destruction which compacts checks the whole data" ) {
+    const uint32_t SIZE_CRC=2048;
+    const uint32_t ELEMENTS=40;
+    char arena[SIZE_CRC] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_CRC]), 64);
+    mockArena.setDeferredFree(true);
+    mockArena.setCompactionThreshold(0);
+
+    cus::CrcVector<uint32_t> vectorA(mockArena);
+    for(uint32_t idx=0;idx<ELEMENTS;idx++) {
+        REQUIRE( vectorA.push_back(idx) == false );
+    }
+    {
+        cus::CrcVector<uint32_t> vectorB(mockArena,{7});
+        // The deallocation of vectorB compacts the whole data, vectorA too
+        vectorA.data()[1] ^= 0x40;
+    }
+    REQUIRE( mockArena.releasedBytes() == 0 );
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[1] == 1 );
+}
+
+TEST_CASE( "Crc self insert", "The source of a self insert is checked before copying it" ) {
+    const uint32_t SIZE_CRC=2048;
+    const uint32_t ELEMENTS=40;
+    char arena[SIZE_CRC] __attribute__ ((aligned (8)));
+    cus::CrcAllocation mockArena(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_CRC]), 64);
+
+    cus::CrcVector<uint32_t> vectorA(mockArena);
+    for(uint32_t idx=0;idx<ELEMENTS;idx++) {
+        REQUIRE( vectorA.push_back(idx) == false );
+    }
+    vectorA.data()[1] ^= 0x40;
+    REQUIRE( vectorA.insert(30, vectorA.data()+1, vectorA.data()+2) == false );
+    REQUIRE( mockArena.checkConsistency() == true );
+    REQUIRE( vectorA[1] == 1 );
+    REQUIRE( vectorA[30] == 1 );
+    REQUIRE( vectorA[31] == 30 );
+
+    // The inline vector rejects a range of itself
+    cus::InlineVector<uint32_t, cus::CrcPolicy> inlineA(mockArena,{1,2});
+    REQUIRE( inlineA.append(inlineA.data(), 1) == true );
+    REQUIRE( inlineA.size() == 2 );
+}
+
+TEST_CASE( "Vector on a pool", "Containers run on a pool beside a compacting arena" ) {
+    const uint32_t SIZE_SECTION=1024;
+    char arena[SIZE_SECTION] __attribute__ ((aligned (8)));
+    cus::PoolAllocation mockPool(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_SECTION/2]));
+    cus::BasicAllocation mockArena(reinterpret_cast<void *>(&arena[SIZE_SECTION/2]), \
+                                   reinterpret_cast<void *>(&arena[SIZE_SECTION]));
+
+    cus::Vector<uint32_t> pooled(mockPool);
+    cus::Vector<uint32_t> compacted(mockArena,{7,8});
+    {
+        cus::Vector<uint32_t> released(mockArena,{1,2,3,4});
+        // The growth moves the object to bigger classes of the pool
+        for(uint32_t idx=0;idx<10;idx++) {
+            REQUIRE( pooled.push_back(idx) == false );
+        }
+        REQUIRE( mockPool.elements() == 1 );
+        REQUIRE( mockPool.sizeElement(pooled.aMem) == 64 );
+        REQUIRE( released.push_back(5) == false );
+    }
+    // The arena compacts its objects while the pool keeps its blocks
+    uint32_t *pooledData = pooled.data();
+    REQUIRE( compacted.push_back(9) == false );
+    REQUIRE( mockArena.elements() == 1 );
+    REQUIRE( pooled.data() == pooledData );
+
+    pooled.erase(2);
+    pooled.erase(0,2);
+    REQUIRE( pooled.size() == 7 );
+    REQUIRE( pooled[0] == 3 );
+    REQUIRE( pooled[6] == 9 );
+    uint32_t values[2] = {20, 21};
+    REQUIRE( pooled.insert(1, &values[0], &values[2]) == false );
+    REQUIRE( pooled.size() == 9 );
+    REQUIRE( pooled[1] == 20 );
+    REQUIRE( pooled[3] == 4 );
+    REQUIRE( pooled.shrink_to_fit() == false );
+    REQUIRE( pooled.capacity() == 9 );
+    REQUIRE( pooled[8] == 9 );
+
+    cus::InlineVector<uint16_t> inlined(mockPool,{1,2,3});
+    REQUIRE( inlined.push_back(4) == false );
+    REQUIRE( mockPool.elements() == 2 );
+    REQUIRE( compacted[2] == 9 );
+    REQUIRE( inlined[3] == 4 );
+}
+
+TEST_CASE( "Vector on a pool erased to empty", "The block is released by shrink_to_fit()" ) {
+    const uint32_t SIZE_SECTION=4096;
+    const uint32_t CYCLES=400;
+    char arena[SIZE_SECTION] __attribute__ ((aligned (8)));
+    cus::PoolAllocation mockPool(reinterpret_cast<void *>(&arena[0]), \
+                                 reinterpret_cast<void *>(&arena[SIZE_SECTION]));
+
+    cus::Vector<uint32_t> pooled(mockPool);
+    bool erased;
+    for(uint32_t idx=0;idx<CYCLES;idx++) {
+        REQUIRE( pooled.push_back(idx) == false );
+        REQUIRE( mockPool.elements() == 1 );
+        if((idx%2)==0) {
+            pooled.erase(0);
+        } else {
+            pooled.erase(0, erased);
+            REQUIRE( erased == true );
+        }
+        REQUIRE( pooled.size() == 0 );
+        REQUIRE( mockPool.elements() == 1 );
+        REQUIRE( pooled.shrink_to_fit() == false );
+        REQUIRE( mockPool.elements() == 0 );
+    }
+    REQUIRE( pooled.push_back(1) == false );
+
+    // A requester which already owns a block can not take another one
+    void *owned = pooled.aMem;
+    REQUIRE( mockPool.allocate((arch_t)&pooled.aMem, pooled.aMem, 8) == false );
+    REQUIRE( pooled.aMem == owned );
+    REQUIRE( mockPool.elements() == 1 );
+}